@@ -0,0 +1,112 @@
+#include <chrono>
+#include <random>
+
+#include "unitree_lidar_utilities.h"
+
+using namespace unilidar_sdk2;
+
+typedef struct
+{
+    const char *name;
+    Crc32Update update;
+} NamedCrc32;
+
+static std::vector<NamedCrc32> availableImplementations()
+{
+    std::vector<NamedCrc32> impls = {{"bitwise", crc32UpdateBitwise}, {"slice8", crc32UpdateSlice8}};
+#if defined(UNILIDAR_CRC32_PCLMUL)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("pclmul") && __builtin_cpu_supports("sse4.1"))
+    {
+        impls.push_back({"pclmul", crc32UpdatePclmul});
+    }
+#elif defined(UNILIDAR_CRC32_ARMV8)
+    if (getauxval(AT_HWCAP) & HWCAP_CRC32)
+    {
+        impls.push_back({"armv8", crc32UpdateArmv8});
+    }
+#endif
+    return impls;
+}
+
+/**
+ * @brief Bytes covered by the frame crc: the data only, between FrameHeader and FrameTail
+ */
+template <typename Packet>
+static constexpr uint32_t crcLength()
+{
+    return sizeof(Packet::data);
+}
+
+typedef struct
+{
+    const char *name;
+    uint32_t len;
+} PacketSize;
+
+int main(int argc, char *argv[])
+{
+    const double seconds_per_case = argc > 1 ? atof(argv[1]) : 0.2;
+
+    const std::vector<PacketSize> packets = {
+        {"LidarUserCtrlCmdPacket", crcLength<LidarUserCtrlCmdPacket>()},
+        {"LidarWorkModeConfigPacket", crcLength<LidarWorkModeConfigPacket>()},
+        {"LidarTimeStampPacket", crcLength<LidarTimeStampPacket>()},
+        {"LidarMacAddressConfigPacket", crcLength<LidarMacAddressConfigPacket>()},
+        {"LidarAckDataPacket", crcLength<LidarAckDataPacket>()},
+        {"LidarIpAddressConfigPacket", crcLength<LidarIpAddressConfigPacket>()},
+        {"LidarVersionDataPacket", crcLength<LidarVersionDataPacket>()},
+        {"LidarImuDataPacket", crcLength<LidarImuDataPacket>()},
+        {"LidarPointDataPacket", crcLength<LidarPointDataPacket>()},
+        {"Lidar2DPointDataPacket", crcLength<Lidar2DPointDataPacket>()},
+    };
+
+    std::mt19937 rng(7);
+    std::vector<uint8_t> buffer(sizeof(Lidar2DPointDataPacket));
+    for (auto &b : buffer)
+    {
+        b = (uint8_t)rng();
+    }
+
+    const auto impls = availableImplementations();
+    printf("%-28s %6s", "packet", "bytes");
+    for (const auto &impl : impls)
+    {
+        printf(" %15s", impl.name);
+    }
+    printf("   (ns per packet)\n");
+
+    bool identical = true;
+    for (const auto &packet : packets)
+    {
+        printf("%-28s %6u", packet.name, packet.len);
+        const uint32_t expected = ~crc32UpdateBitwise(0xFFFFFFFF, buffer.data(), packet.len);
+
+        for (const auto &impl : impls)
+        {
+            uint32_t crc = 0;
+            size_t calls = 0;
+            double elapsed = 0;
+            auto t0 = std::chrono::steady_clock::now();
+            while (elapsed < seconds_per_case)
+            {
+                for (int k = 0; k < 256; k++)
+                {
+                    crc = ~impl.update(0xFFFFFFFF, buffer.data(), packet.len);
+                }
+                calls += 256;
+                elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+            }
+            identical = identical && crc == expected;
+            printf(" %13.1f%s", elapsed / calls * 1e9, crc == expected ? "  " : " !");
+        }
+        printf("\n");
+    }
+
+    if (!identical)
+    {
+        printf("crc mismatch against the bitwise reference (marked with !)\n");
+        return 1;
+    }
+    return 0;
+}
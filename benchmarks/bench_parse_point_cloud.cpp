@@ -0,0 +1,261 @@
+#include <chrono>
+#include <random>
+
+#include "unitree_lidar_utilities.h"
+
+using namespace unilidar_sdk2;
+
+/**
+ * @brief The per-point sin/cos implementation of parseFromPacketToPointCloud,
+ *        kept here as the baseline
+ */
+static void parseFromPacketToPointCloudLegacy(
+    PointCloudUnitree &cloud,
+    const LidarPointDataPacket &packet,
+    float range_min = 0,
+    float range_max = 100)
+{
+    const int num_of_points = packet.data.point_num;
+    const float time_step = packet.data.time_increment;
+
+    const float sin_beta = sin(packet.data.param.beta_angle);
+    const float cos_beta = cos(packet.data.param.beta_angle);
+    const float sin_xi = sin(packet.data.param.xi_angle);
+    const float cos_xi = cos(packet.data.param.xi_angle);
+    const float cos_beta_sin_xi = cos_beta * sin_xi;
+    const float sin_beta_cos_xi = sin_beta * cos_xi;
+    const float sin_beta_sin_xi = sin_beta * sin_xi;
+    const float cos_beta_cos_xi = cos_beta * cos_xi;
+
+    cloud.points.clear();
+    cloud.points.reserve(300);
+
+    auto &ranges = packet.data.ranges;
+    auto &intensities = packet.data.intensities;
+
+    float time_relative = 0;
+    float alpha_cur = packet.data.angle_min + packet.data.param.alpha_angle_bias;
+    float alpha_step = packet.data.angle_increment;
+    float theta_cur = packet.data.com_horizontal_angle_start + packet.data.param.theta_angle_bias;
+    float theta_step = packet.data.com_horizontal_angle_step;
+
+    PointUnitree point3d;
+    point3d.ring = 1;
+
+    for (int j = 0; j < num_of_points; j += 1, alpha_cur += alpha_step,
+             theta_cur += theta_step, time_relative += time_step)
+    {
+        if (ranges[j] < 1)
+        {
+            continue;
+        }
+        float range_float = packet.data.param.range_scale * ((float)ranges[j] + packet.data.param.range_bias);
+        if (range_float < packet.data.range_min || range_float > packet.data.range_max)
+        {
+            continue;
+        }
+        if (range_float < range_min || range_float > range_max)
+        {
+            continue;
+        }
+
+        float sin_alpha = sin(alpha_cur);
+        float cos_alpha = cos(alpha_cur);
+        float sin_theta = sin(theta_cur);
+        float cos_theta = cos(theta_cur);
+
+        float A = (-cos_beta_sin_xi + sin_beta_cos_xi * sin_alpha) * range_float + packet.data.param.b_axis_dist;
+        float B = cos_alpha * cos_xi * range_float;
+        float C = (sin_beta_sin_xi + cos_beta_cos_xi * sin_alpha) * range_float;
+
+        point3d.x = cos_theta * A - sin_theta * B;
+        point3d.y = sin_theta * A + cos_theta * B;
+        point3d.z = C + packet.data.param.a_axis_dist;
+        point3d.intensity = intensities[j];
+        point3d.time = time_relative;
+        cloud.points.push_back(point3d);
+    }
+}
+
+/**
+ * @brief Synthetic packets with a typical calibration, 1 of 20 ranges invalid
+ */
+static std::vector<LidarPointDataPacket> makePackets(int num_packets)
+{
+    std::mt19937 rng(42);
+    std::uniform_int_distribution<int> range_mm(50, 30000);
+    std::uniform_int_distribution<int> intensity(0, 255);
+    std::uniform_int_distribution<int> invalid(0, 19);
+
+    std::vector<LidarPointDataPacket> packets(num_packets);
+    for (int i = 0; i < num_packets; i++)
+    {
+        LidarPointData &data = packets[i].data;
+        memset(&data, 0, sizeof(LidarPointData));
+
+        data.param.a_axis_dist = 0.0076f;
+        data.param.b_axis_dist = 0.0106f;
+        data.param.theta_angle_bias = 0.0021f;
+        data.param.alpha_angle_bias = -0.0035f;
+        data.param.beta_angle = 0.0114f;
+        data.param.xi_angle = -0.0017f;
+        data.param.range_bias = -2.5f;
+        data.param.range_scale = 0.001f;
+
+        data.com_horizontal_angle_start = fmodf(i * 0.0172f, 2 * M_PI);
+        data.com_horizontal_angle_step = 5.73e-5f;
+        data.scan_period = 0.0054f;
+        data.range_min = 0.05f;
+        data.range_max = 30.0f;
+        data.angle_min = -0.1f;
+        data.angle_increment = 0.0209f;
+        data.time_increment = 1.8e-5f;
+        data.point_num = 300;
+
+        for (int j = 0; j < 300; j++)
+        {
+            data.ranges[j] = invalid(rng) == 0 ? 0 : range_mm(rng);
+            data.intensities[j] = intensity(rng);
+        }
+    }
+    return packets;
+}
+
+template <typename Parse>
+static double pointsPerSecond(const std::vector<LidarPointDataPacket> &packets, int rounds, Parse parse)
+{
+    PointCloudUnitree cloud;
+    size_t points = 0;
+
+    auto t0 = std::chrono::steady_clock::now();
+    for (int r = 0; r < rounds; r++)
+    {
+        for (const auto &packet : packets)
+        {
+            parse(cloud, packet);
+            points += cloud.points.size();
+        }
+    }
+    auto t1 = std::chrono::steady_clock::now();
+    return points / std::chrono::duration<double>(t1 - t0).count();
+}
+
+typedef struct
+{
+    const char *name;
+    ProjectionKernel kernel;
+} NamedKernel;
+
+static std::vector<NamedKernel> availableKernels()
+{
+    std::vector<NamedKernel> kernels = {{"scalar", projectPointsScalar}};
+#if defined(UNILIDAR_KERNELS_X86)
+    kernels.push_back({"sse2", projectPointsSse2});
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+    {
+        kernels.push_back({"avx2", projectPointsAvx2});
+    }
+#elif defined(UNILIDAR_KERNELS_NEON)
+    kernels.push_back({"neon", projectPointsNeon});
+#endif
+    return kernels;
+}
+
+/**
+ * @brief Run every kernel over the packets, compare with the scalar kernel bit by bit
+ * @return false on any mismatch
+ */
+static bool benchmarkKernels(const std::vector<LidarPointDataPacket> &packets, int rounds)
+{
+    const int capacity = PointCloudProjector::MAX_POINT_NUM + PROJECTION_KERNEL_SLACK;
+    const size_t total = packets.size() * capacity;
+
+    std::vector<float> ref(5 * total, 0), col(5 * total, 0);
+    std::vector<int> ref_num(packets.size()), num(packets.size());
+    auto columns = [&](std::vector<float> &buf, size_t i)
+    {
+        float *base = buf.data() + i * capacity;
+        return ProjectionKernelOutput{base, base + total, base + 2 * total, base + 3 * total, base + 4 * total};
+    };
+
+    PointCloudProjector projector;
+    bool identical = true;
+    for (const auto &named : availableKernels())
+    {
+        std::vector<float> &buf = named.kernel == projectPointsScalar ? ref : col;
+        std::vector<int> &counts = named.kernel == projectPointsScalar ? ref_num : num;
+
+        size_t points = 0;
+        auto t0 = std::chrono::steady_clock::now();
+        for (int r = 0; r < rounds; r++)
+        {
+            for (size_t i = 0; i < packets.size(); i++)
+            {
+                counts[i] = projector.project(columns(buf, i), packets[i].data, 0, 100, named.kernel);
+                points += counts[i];
+            }
+        }
+        auto t1 = std::chrono::steady_clock::now();
+
+        bool same = true;
+        if (named.kernel != projectPointsScalar)
+        {
+            for (size_t i = 0; i < packets.size() && same; i++)
+            {
+                const ProjectionKernelOutput a = columns(ref, i), b = columns(col, i);
+                same = ref_num[i] == num[i] &&
+                       memcmp(a.x, b.x, num[i] * sizeof(float)) == 0 &&
+                       memcmp(a.y, b.y, num[i] * sizeof(float)) == 0 &&
+                       memcmp(a.z, b.z, num[i] * sizeof(float)) == 0 &&
+                       memcmp(a.intensity, b.intensity, num[i] * sizeof(float)) == 0 &&
+                       memcmp(a.time, b.time, num[i] * sizeof(float)) == 0;
+            }
+        }
+        identical = identical && same;
+
+        printf("kernel %-6s : %10.2f Mpoints/s%s\n", named.name,
+               points / std::chrono::duration<double>(t1 - t0).count() / 1e6,
+               same ? "" : "  MISMATCH against scalar");
+    }
+    return identical;
+}
+
+int main(int argc, char *argv[])
+{
+    const int num_packets = 1000;
+    const int rounds = argc > 1 ? atoi(argv[1]) : 50;
+    const auto packets = makePackets(num_packets);
+
+    // accuracy of the cached projection against the legacy implementation
+    double max_diff = 0;
+    PointCloudUnitree legacy, cached;
+    for (const auto &packet : packets)
+    {
+        parseFromPacketToPointCloudLegacy(legacy, packet);
+        parseFromPacketToPointCloud(cached, packet);
+        if (legacy.points.size() != cached.points.size())
+        {
+            printf("point count mismatch: %zu vs %zu\n", legacy.points.size(), cached.points.size());
+            return 1;
+        }
+        for (size_t k = 0; k < legacy.points.size(); k++)
+        {
+            max_diff = std::max<double>(max_diff, fabs(legacy.points[k].x - cached.points[k].x));
+            max_diff = std::max<double>(max_diff, fabs(legacy.points[k].y - cached.points[k].y));
+            max_diff = std::max<double>(max_diff, fabs(legacy.points[k].z - cached.points[k].z));
+        }
+    }
+    printf("max abs xyz difference to legacy = %.6f m\n", max_diff);
+
+    double before = pointsPerSecond(packets, rounds, [](PointCloudUnitree &cloud, const LidarPointDataPacket &packet)
+                                    { parseFromPacketToPointCloudLegacy(cloud, packet); });
+    double after = pointsPerSecond(packets, rounds, [](PointCloudUnitree &cloud, const LidarPointDataPacket &packet)
+                                   { parseFromPacketToPointCloud(cloud, packet); });
+
+    printf("legacy (sin/cos per point) : %10.2f Mpoints/s\n", before / 1e6);
+    printf("cached projection          : %10.2f Mpoints/s\n", after / 1e6);
+    printf("speedup                    : %10.2fx\n", after / before);
+
+    return benchmarkKernels(packets, rounds) ? 0 : 1;
+}
@@ -3,20 +3,22 @@ import logging
 from collections import deque
 
 try:
+    import grid
     import lidar
 except ImportError:
     try:
         import os, sys
 
         sys.path.append(os.path.join(os.path.dirname(os.path.abspath(__file__)), 'build'))
+        import grid
         import lidar
     except ImportError:
-        print("Failed to import the lidar module. Please ensure the build path is imported correctly.")
+        print("Failed to import the grid/lidar modules. Please ensure the build path is imported correctly.")
         sys.exit(1)
 
 from pylib.args import load_config, save_config
 from pylib.args import get_client_parser, client_gui_args
-from pylib.work import workflow, send_results_to_reporting_server, send_results_to_visualization_server
+from pylib.work import workflow, create_fleet, fleet_site_length, send_results_to_reporting_server, send_results_to_visualization_server
 
 logger = logging.getLogger()
 
@@ -52,41 +54,115 @@ def pre_setup(args):
     logger.info(f"Setup complete. Logs will be saved to {log_file}.")
 
 
+def load_fleet_configs(args):
+    """ Configurations of the Lidars of the fleet: this one, then the ones of --fleet_configs.
+
+    Args:
+        args (argparse.Namespace): Parsed command line arguments.
+    """
+    configs = []
+    for path, config in [('', vars(args))] + [(path, load_config(path)) for path in args.fleet_configs]:
+        if not config:
+            raise ValueError(f"Fleet config {path} is missing or empty.")
+        connect_type = config.get('connect_type', 0)
+        if connect_type not in (0, 3):
+            raise ValueError(f"Lidar {config['lidar_ip']} must use UDP (connect_type 0 or 3) to join the fleet.")
+        ## the fleet reads a Lidar in batches only if it was configured to
+        configs.append({**config, 'udp_batch': config.get('udp_batch', 64) if connect_type == 3 else 0})
+    return configs
+
+
+def start_lidars(manager):
+    """ Start the rotation of the Lidar, or of every Lidar of the fleet."""
+    if isinstance(manager, lidar.LidarFleet):
+        for device in range(len(manager)):
+            manager.startLidar(device)
+    else:
+        manager.startLidar()
+
+
+def stop_lidars(manager):
+    """ Stop the rotation of the Lidar, or of every Lidar of the fleet."""
+    if isinstance(manager, lidar.LidarFleet):
+        for device in range(len(manager)):
+            manager.stopLidar(device)
+    else:
+        manager.stopLidar()
+
+
 def run_logic(args):
     """ Main process for Lidar detection.
 
     Args:
         args (argparse.Namespace): Parsed command line arguments.
     """
-    ## initialize Lidar manager
-    manager = lidar.LidarManager()
-    logger.info("Starting Lidar...")
-    if args.connect_type == 0:
-        manager.initLidarWithUDP(
-            args.lidar_ip, args.lidar_port,
-            args.local_ip, args.local_port
-        )
-    elif args.connect_type == 1:
-        manager.initLidarWithSerial()
+    ## initialize Lidar manager, or the fleet of the Lidars fused into one grid
+    fleet = len(args.fleet_configs) > 0
+    if fleet:
+        logger.info("Starting Lidar fleet...")
+        fleet_configs = load_fleet_configs(args)
+        manager = create_fleet(fleet_configs)
+        ## the fused grid covers the crop squares of every Lidar moved into the site frame
+        map_length = fleet_site_length(fleet_configs)
+        logger.info(f"Height map of the fleet covers [-{map_length:.3f}, {map_length:.3f}) m around the site origin.")
+        if args.record_file:
+            logger.warning("Recording is not supported by the fleet, --record_file is ignored.")
     else:
-        logger.error("Unsupported connection type. Use 0 for UDP and 1 for Serial.")
-        return
+        manager = lidar.LidarManager()
+        map_length = args.space_region_threshold
+        logger.info("Starting Lidar...")
+        if args.connect_type == 0:
+            manager.initLidarWithUDP(
+                args.lidar_ip, args.lidar_port,
+                args.local_ip, args.local_port
+            )
+        elif args.connect_type == 1:
+            manager.initLidarWithSerial()
+        elif args.connect_type == 2:
+            manager.initLidarWithReplay(args.replay_file, speed=args.replay_speed, loop=True)
+        elif args.connect_type == 3:
+            manager.initLidarWithBatchedUDP(
+                args.lidar_ip, args.lidar_port,
+                args.local_ip, args.local_port,
+                batch=args.udp_batch, receiveBuffer=args.udp_receive_buffer
+            )
+        else:
+            logger.error("Unsupported connection type. Use 0 for UDP, 1 for Serial, 2 for replay and 3 for batched UDP.")
+            return
+        if args.record_file:
+            manager.startRecording(args.record_file)
     time.sleep(1)  ## wait for the Lidar to initialize
-    manager.startLidar()
+    start_lidars(manager)
     time.sleep(args.START_LIDAR_WAIT_TIME)  ## wait for the Lidar to start
 
+    ## crop the points natively while packets are parsed, only the region of interest reaches python
+    ## (the fleet crops every Lidar with the thresholds of its own config)
+    if not fleet:
+        manager.enablePipeline(args.space_region_threshold, args.lidar_height_threshold, deskew=args.deskew)
+
     ## Main loop to process point cloud data
     logger.info("Entering main loop...\n\n\n")
     try:
         assert args.HISTORY_WINDOW_SIZE <= 6, "HISTORY_WINDOW_SIZE should be at most 6."
         history = deque(maxlen=args.HISTORY_WINDOW_SIZE - 1)
+        ## fixed height map of the storage area, holds the collections of one cycle
+        height_map = grid.HeightMap(
+            length=map_length,
+            grid_size=args.grid_size,
+            collections=args.collection_times_per_cycle
+        )
         current_round = 1
         while True:
             start_time = time.time()
             logger.info('-' * 25 + ' Beigin Processing ' + '-' * 25)
 
-            ## get results from workflow
-            results = workflow(args, manager, history)
+            ## get results from workflow, packets are parsed on the native thread meanwhile
+            if fleet:
+                manager.startStreaming(threads=0)  ## one native thread per Lidar
+            else:
+                manager.startStreaming()
+            results = workflow(args, manager, history, height_map)
+            manager.stopStreaming()
             if results is None:
                 time.sleep(1)
                 continue
@@ -125,10 +201,10 @@ def run_logic(args):
             if args.enable_start_stop and waiting_time > 3 * args.START_LIDAR_WAIT_TIME:
                 ## enable start/stop functionality only if the report interval is larger than 3 times of the start wait time
                 logger.info("Stopping Lidar for the next cycle...")
-                manager.stopLidar()
+                stop_lidars(manager)
                 time.sleep(waiting_time - args.START_LIDAR_WAIT_TIME)
                 logger.info("Restarting Lidar...")
-                manager.startLidar()
+                start_lidars(manager)
                 time.sleep(args.START_LIDAR_WAIT_TIME)
             else:
                 time.sleep(waiting_time)
@@ -140,7 +216,13 @@ def run_logic(args):
         logger.error(f"An error occurred: {e}")
     finally:
         logger.info("Stopping Lidar...")
-        manager.stopLidar()
+        manager.stopStreaming()
+        if args.record_file and not fleet:
+            try:
+                manager.stopRecording()
+            except RuntimeError as e:
+                logger.error(f"{e}")
+        stop_lidars(manager)
         time.sleep(1)
 
 
@@ -0,0 +1,305 @@
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <cmath>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "lidar_capture.h"
+
+using namespace unilidar_sdk2;
+
+/**
+ * @brief Framed point packet of a sensor turning at 1 / (18 * scan_period) Hz
+ */
+static LidarPointDataPacket makePointPacket(std::mt19937 &rng, uint32_t seq)
+{
+    LidarPointDataPacket packet;
+    memset(&packet, 0, sizeof(packet));
+    LidarPointData &data = packet.data;
+    data.info.seq = seq;
+    data.param.range_scale = 0.001f;
+    data.com_horizontal_angle_start = 0.35f * (seq % 18);
+    data.com_horizontal_angle_step = 0.35f / 120;
+    data.scan_period = 0.1f / 18;
+    data.range_min = 0.05f;
+    data.range_max = 30.0f;
+    data.angle_min = -1.5f;
+    data.angle_increment = 3.0f / 120;
+    data.time_increment = data.scan_period / 120;
+    data.point_num = 120;
+    for (uint32_t i = 0; i < data.point_num; i++)
+    {
+        data.ranges[i] = (uint16_t)(200 + rng() % 20000);
+        data.intensities[i] = (uint8_t)rng();
+    }
+    framePacket(packet, LIDAR_POINT_DATA_PACKET_TYPE);
+    return packet;
+}
+
+/**
+ * @brief checkPacketFrame() accepts the packets of framePacket() and nothing else
+ */
+template <typename Packet>
+static int checkFraming(const Packet &packet, uint32_t packet_type)
+{
+    int failures = 0;
+    std::vector<uint8_t> buf((const uint8_t *)&packet, (const uint8_t *)&packet + sizeof(Packet));
+    if (checkPacketFrame(buf.data(), buf.size()) != packet_type)
+    {
+        printf("packet type %u: well formed packet rejected\n", packet_type);
+        failures++;
+    }
+
+    // flipped bit of the data, header, size, tail, truncated and padded datagrams
+    const size_t corruptions[] = {sizeof(FrameHeader) + sizeof(Packet) / 2, 0, 3, 8, sizeof(Packet) - 1};
+    for (size_t offset : corruptions)
+    {
+        std::vector<uint8_t> bad = buf;
+        bad[offset] ^= 0x10;
+        if (checkPacketFrame(bad.data(), bad.size()) != 0)
+        {
+            printf("packet type %u: corrupted byte %zu accepted\n", packet_type, offset);
+            failures++;
+        }
+    }
+    std::vector<uint8_t> padded = buf;
+    padded.push_back(0);
+    if (checkPacketFrame(buf.data(), buf.size() - 1) != 0 || checkPacketFrame(padded.data(), padded.size()) != 0 ||
+        checkPacketFrame(buf.data(), sizeof(FrameHeader)) != 0)
+    {
+        printf("packet type %u: datagram of the wrong size accepted\n", packet_type);
+        failures++;
+    }
+    return failures;
+}
+
+int main()
+{
+    std::mt19937 rng(9);
+    const int cloud_scan_num = 18;
+    int failures = 0;
+
+    std::vector<LidarPointDataPacket> points;
+    for (uint32_t seq = 0; seq < 2 * cloud_scan_num + 5; seq++)
+    {
+        points.push_back(makePointPacket(rng, seq));
+    }
+
+    LidarImuDataPacket imu;
+    memset(&imu, 0, sizeof(imu));
+    imu.data.info.seq = 7;
+    imu.data.quaternion[3] = 1.0f;
+    imu.data.linear_acceleration[2] = 9.81f;
+    framePacket(imu, LIDAR_IMU_DATA_PACKET_TYPE);
+
+    LidarVersionDataPacket version;
+    memset(&version, 0, sizeof(version));
+    const uint8_t sw_version[4] = {2, 4, 1, 3};
+    memcpy(version.data.sw_version, sw_version, sizeof(sw_version));
+    framePacket(version, LIDAR_VERSION_PACKET_TYPE);
+
+    failures += checkFraming(points[0], LIDAR_POINT_DATA_PACKET_TYPE);
+    failures += checkFraming(imu, LIDAR_IMU_DATA_PACKET_TYPE);
+    failures += checkFraming(version, LIDAR_VERSION_PACKET_TYPE);
+
+    // record a session: version, then an imu packet every 4 point packets
+    char path[] = "/tmp/check_capture_XXXXXX";
+    const int fd = mkstemp(path);
+    if (fd < 0)
+    {
+        printf("can not create a temporary capture\n");
+        return 1;
+    }
+    close(fd);
+
+    std::vector<int> recorded_types;
+    std::vector<double> recorded_stamps;
+    LidarCaptureWriter writer;
+    if (!writer.open(path))
+    {
+        printf("can not write %s\n", path);
+        return 1;
+    }
+    const double first_stamp = 1.7e9;
+    writer.write(LIDAR_VERSION_PACKET_TYPE, &version, sizeof(version), first_stamp);
+    recorded_types.push_back(LIDAR_VERSION_PACKET_TYPE);
+    recorded_stamps.push_back(first_stamp);
+    for (size_t k = 0; k < points.size(); k++)
+    {
+        const double stamp = first_stamp + (k + 1) * (double)points[k].data.scan_period;
+        writer.write(LIDAR_POINT_DATA_PACKET_TYPE, &points[k], sizeof(LidarPointDataPacket), stamp);
+        recorded_types.push_back(LIDAR_POINT_DATA_PACKET_TYPE);
+        recorded_stamps.push_back(stamp);
+        if (k % 4 == 3)
+        {
+            writer.write(LIDAR_IMU_DATA_PACKET_TYPE, &imu, sizeof(imu), stamp);
+            recorded_types.push_back(LIDAR_IMU_DATA_PACKET_TYPE);
+            recorded_stamps.push_back(stamp);
+        }
+    }
+
+    if (!writer.close() || writer.records() != recorded_types.size())
+    {
+        printf("the capture was not closed cleanly after %zu records\n", writer.records());
+        failures++;
+    }
+
+    // a full disk stops the recording and is reported, at the latest when the capture is closed
+    LidarCaptureWriter full_writer;
+    if (full_writer.open("/dev/full"))
+    {
+        size_t written = 0;
+        while (written < 1000 &&
+               full_writer.write(LIDAR_POINT_DATA_PACKET_TYPE, &points[0], sizeof(LidarPointDataPacket), first_stamp))
+        {
+            written++;
+        }
+        if (!full_writer.failed() || full_writer.isOpen() || full_writer.close())
+        {
+            printf("writing %zu records to a full disk was not reported\n", written);
+            failures++;
+        }
+    }
+
+    // a record too large for any packet or of an unknown type ends the capture, the valid
+    // record after it is not replayed
+    const CaptureRecordHeader corrupt[] = {{0, LIDAR_POINT_DATA_PACKET_TYPE, 0xfffffff0u}, {0, 0x55, 0}};
+    for (const CaptureRecordHeader &header : corrupt)
+    {
+        char corrupt_path[] = "/tmp/check_capture_XXXXXX";
+        const int corrupt_fd = mkstemp(corrupt_path);
+        close(corrupt_fd);
+        writer.open(corrupt_path);
+        writer.write(LIDAR_IMU_DATA_PACKET_TYPE, &imu, sizeof(imu), first_stamp);
+        writer.close();
+
+        const CaptureRecordHeader valid = {0, LIDAR_IMU_DATA_PACKET_TYPE, sizeof(imu)};
+        FILE *file = fopen(corrupt_path, "ab");
+        fwrite(&header, sizeof(header), 1, file);
+        fwrite(&valid, sizeof(valid), 1, file);
+        fwrite(&imu, sizeof(imu), 1, file);
+        fclose(file);
+
+        ReplayLidarReader corrupt_reader;
+        int replayed = 0;
+        if (corrupt_reader.initializeReplay(corrupt_path, 0, false, cloud_scan_num) == 0)
+        {
+            // a finished replay keeps returning 0, records after the corrupt one would not
+            for (int poll = 0; poll < 4; poll++)
+            {
+                replayed += corrupt_reader.runParse() != 0;
+            }
+        }
+        if (replayed != 1)
+        {
+            printf("capture with a record of type %u and size %u: %d records replayed, expected 1\n",
+                   header.packet_type, header.size, replayed);
+            failures++;
+        }
+        corrupt_reader.closeReplay();
+        unlink(corrupt_path);
+    }
+
+    // play it back as fast as possible, every record comes out once and unchanged
+    ReplayLidarReader reader;
+    if (reader.initializeReplay(path, 0, false, cloud_scan_num) != 0)
+    {
+        printf("can not replay %s\n", path);
+        return 1;
+    }
+
+    std::vector<int> replayed_types;
+    size_t point_index = 0;
+    int clouds = 0;
+    double stamp_offset = 0;
+    double first_cloud_stamp = 0;
+    for (int result; (result = reader.runParse()) != 0;)
+    {
+        // packets keep their recorded spacing, shifted to the start of the replay
+        const size_t record = replayed_types.size();
+        replayed_types.push_back(result);
+        if (record == 0)
+        {
+            stamp_offset = reader.lastPacketStamp() - recorded_stamps[0];
+        }
+        if (record < recorded_stamps.size() &&
+            std::fabs(reader.lastPacketStamp() - (recorded_stamps[record] + stamp_offset)) > 1e-5)
+        {
+            printf("record %zu stamped %.6f, recorded %.6f\n", record, reader.lastPacketStamp() - stamp_offset,
+                   recorded_stamps[record]);
+            failures++;
+        }
+        if (result == LIDAR_POINT_DATA_PACKET_TYPE && point_index % cloud_scan_num == 0)
+        {
+            first_cloud_stamp = reader.lastPacketStamp() - reader.getLidarPointDataPacket().data.scan_period;
+        }
+        if (result == LIDAR_POINT_DATA_PACKET_TYPE)
+        {
+            if (point_index >= points.size() ||
+                memcmp(&reader.getLidarPointDataPacket(), &points[point_index], sizeof(LidarPointDataPacket)) != 0)
+            {
+                printf("point packet %zu differs from the recorded one\n", point_index);
+                failures++;
+            }
+            point_index++;
+
+            PointCloudUnitree cloud;
+            if (reader.getPointCloud(cloud))
+            {
+                clouds++;
+                if (point_index % cloud_scan_num != 0 || cloud.points.empty())
+                {
+                    printf("cloud %d completed after %zu packets with %zu points\n", clouds, point_index,
+                           cloud.points.size());
+                    failures++;
+                }
+                if (std::fabs(cloud.stamp - first_cloud_stamp) > 1e-5)
+                {
+                    printf("cloud %d stamped %.6f, its first scan started at %.6f\n", clouds, cloud.stamp,
+                           first_cloud_stamp);
+                    failures++;
+                }
+                if (cloud.id != (uint32_t)clouds)
+                {
+                    printf("cloud %d numbered %u\n", clouds, cloud.id);
+                    failures++;
+                }
+            }
+        }
+        else if (result == LIDAR_IMU_DATA_PACKET_TYPE)
+        {
+            LidarImuData data;
+            if (!reader.getImuData(data) || memcmp(&data, &imu.data, sizeof(data)) != 0)
+            {
+                printf("imu packet differs from the recorded one\n");
+                failures++;
+            }
+        }
+    }
+
+    std::string firmware;
+    reader.getVersionOfLidarFirmware(firmware);
+    if (firmware != "2.4.1.3")
+    {
+        printf("firmware version %s, expected 2.4.1.3\n", firmware.c_str());
+        failures++;
+    }
+    if (replayed_types != recorded_types || clouds != (int)points.size() / cloud_scan_num)
+    {
+        printf("replayed %zu records and %d clouds, recorded %zu records\n", replayed_types.size(), clouds,
+               recorded_types.size());
+        failures++;
+    }
+    reader.closeReplay();
+    unlink(path);
+
+    if (failures > 0)
+    {
+        printf("capture: %d failures\n", failures);
+        return 1;
+    }
+    printf("capture: %zu records, ok\n", recorded_types.size());
+    return 0;
+}
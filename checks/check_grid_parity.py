@@ -0,0 +1,195 @@
+""" grid.compute_metrics_with_grid against the Python implementation it replaced.
+
+The oracle below is pylib.utils.compute_metrics_with_grid as it was before the native grid module, kept
+verbatim. Both must return identical metrics (compared with ==) on fixed collections covering cell
+boundaries, the truncating cell cast of negative coordinates, points on the upper edge of the grid, points
+on or below the floor, NaN heights and empty collections. Run with the grid module on PYTHONPATH.
+"""
+import sys
+
+import numpy as np
+
+import grid
+
+
+def compute_metrics_with_grid(all_collections_points, floor_height, grid_size=0.1, alert_height=0.0, area_scale=1.0,
+                              height_scale=1.0,
+                              min_valid_collections=2):
+    """
+    Args:
+        all_collections_points (np.ndarray): Store collection_times_per_cycle batches of goods in a flat point cloud.
+        floor_height (float): Height of the floor plane.
+        grid_size_cm (float): grid side length, in cm
+        alert_height (float): Alarm height (m), used to determine the quadrant
+        area_scale (float): Scale factor for the computed area.
+        height_scale (float): Scale factor for the computed height.
+    """
+    import numpy as np
+    if not all_collections_points:
+        return 0.0, 0.0, 0.0, 0.0, 0  # volume, area, max_h, mean_h, quadrant
+
+    # Combine all non-empty collections to determine overall spatial extent
+    all_points = np.vstack([p for p in all_collections_points if len(p) > 0])
+    if len(all_points) == 0:
+        return 0.0, 0.0, 0.0, 0.0, 0
+
+    # Calculate XY boundaries of the combined point cloud
+    min_x, max_x = np.min(all_points[:, 0]), np.max(all_points[:, 0])
+    min_y, max_y = np.min(all_points[:, 1]), np.max(all_points[:, 1])
+
+    # Determine grid dimensions based on spatial extent and grid size
+    grid_x_count = int(np.ceil((max_x - min_x) / grid_size))
+    grid_y_count = int(np.ceil((max_y - min_y) / grid_size))
+
+    collection_grid_data = []  # Store grid data for each collection
+
+    for collection_points in all_collections_points:
+        if len(collection_points) == 0:
+            # Empty collection: store empty dict
+            collection_grid_data.append({})
+            continue
+
+        # Map each point to its corresponding grid cell
+        ix = ((collection_points[:, 0] - min_x) / grid_size).astype(int)
+        iy = ((collection_points[:, 1] - min_y) / grid_size).astype(int)
+
+        # Filter out points that fall outside the grid boundaries
+        valid_mask = (ix >= 0) & (ix < grid_x_count) & (iy >= 0) & (iy < grid_y_count)
+        ix_valid = ix[valid_mask]
+        iy_valid = iy[valid_mask]
+        valid_points = collection_points[valid_mask]
+
+        # Create grid dictionary: key=(gx, gy), value=point indices
+        grid_dict = {}
+        for idx, (gx, gy) in enumerate(zip(ix_valid, iy_valid)):
+            grid_dict.setdefault((gx, gy), []).append(idx)
+
+        # For each grid, store the maximum height in this collection
+        grid_heights = {}
+        for (gx, gy), idx_list in grid_dict.items():
+            cell_points = valid_points[idx_list]
+            # Calculate height for each point and take maximum
+            heights = floor_height - cell_points[:, 2]
+            valid_heights = heights[heights > 0]  # Only consider points above floor
+            if len(valid_heights) > 0:
+                grid_heights[(gx, gy)] = np.max(valid_heights)
+
+        collection_grid_data.append(grid_heights)
+
+    # Count the effective collection times and total height of each grid
+    grid_valid_counts = np.zeros((grid_x_count, grid_y_count), dtype=int)
+    grid_height_sums = np.zeros((grid_x_count, grid_y_count))
+
+    # Process each collection's grid data
+    for grid_heights in collection_grid_data:
+        for (gx, gy), height in grid_heights.items():
+            if 0 <= gx < grid_x_count and 0 <= gy < grid_y_count:
+                grid_valid_counts[gx, gy] += 1
+                grid_height_sums[gx, gy] += height
+
+    total_volume = 0.0
+    total_area = 0.0
+    heights = []
+    max_height = -1
+    max_height_xy = (0, 0)
+    cell_area = grid_size * grid_size
+
+    # Process each grid cell to compute final metrics
+    for gx in range(grid_x_count):
+        for gy in range(grid_y_count):
+            n = grid_valid_counts[gx, gy]  # Number of collections that detected this grid
+
+            if n >= min_valid_collections:
+                # Height = average of the highest points in n collections
+                avg_height = (grid_height_sums[gx, gy] / n) * height_scale
+                volume = avg_height * (cell_area * area_scale)
+                area = cell_area * area_scale
+
+                total_volume += volume
+                total_area += area
+                heights.append(avg_height)
+
+                if avg_height > max_height:
+                    max_height = avg_height
+                    max_height_xy = (min_x + (gx + 0.5) * grid_size, min_y + (gy + 0.5) * grid_size)
+
+    mean_height = np.mean(heights) if len(heights) > 0 else 0.0
+
+    quadrant = 0
+    if max_height > alert_height:
+        x, y = max_height_xy
+        if x >= 0 and y >= 0:
+            quadrant = 1
+        elif x < 0 and y >= 0:
+            quadrant = 2
+        elif x < 0 and y < 0:
+            quadrant = 3
+        elif x >= 0 and y < 0:
+            quadrant = 4
+
+    return total_volume, total_area, max_height, mean_height, quadrant
+
+
+def make_collections(rng, floor_height, grid_size):
+    """ Collections of the storage area [-2, 2]^2, z+ pointing downwards like the Lidar frame. """
+    collections = []
+    for k in range(4):
+        n = 2000 + 500 * k
+        xy = rng.uniform(-2.0, 2.0, size=(n, 2))
+        z = rng.uniform(floor_height - 1.0, floor_height + 0.2, size=(n, 1))
+        collections.append(np.hstack([xy, z]))
+
+    # corners pinning min/max so that the upper edge is a whole number of cells away: points on it are dropped
+    corners = np.array([[-2.0, -2.0, floor_height - 0.3], [2.0, 2.0, floor_height - 0.4]])
+
+    # cell boundaries of negative coordinates and the values just below and above them, where the
+    # truncating cast of (x - min_x) / grid_size decides the cell
+    edges = -2.0 + grid_size * np.arange(0, 20)
+    around = np.concatenate([edges, np.nextafter(edges, -np.inf), np.nextafter(edges, np.inf)])
+    around = around[around >= -2.0]
+    gx, gy = np.meshgrid(around, around[::7])
+    boundary = np.column_stack([gx.ravel(), gy.ravel(), np.full(gx.size, floor_height - 0.25)])
+
+    # floor and below-floor points only, and NaN heights
+    floor = np.column_stack([rng.uniform(-2.0, 0.0, size=(200, 2)), np.full(200, floor_height)])
+    below = np.column_stack([rng.uniform(0.0, 2.0, size=(200, 2)), np.full(200, floor_height + 0.1)])
+    nan = np.column_stack([rng.uniform(-2.0, 2.0, size=(50, 2)), np.full(50, np.nan)])
+
+    collections[0] = np.vstack([collections[0], corners, boundary])
+    collections[1] = np.vstack([collections[1], boundary, floor])
+    collections[2] = np.vstack([collections[2], below, nan])
+    return collections[:2] + [np.zeros((0, 3))] + collections[2:]
+
+
+def main():
+    rng = np.random.default_rng(7)
+    floor_height = 1.5
+    grid_size = 0.1
+    collections = make_collections(rng, floor_height, grid_size)
+
+    failures = 0
+    cases = 0
+    for window in (collections, collections[:1], collections[1:3], collections[3:]):
+        for min_valid in (1, 2, 3):
+            for alert_height in (0.0, 0.8):
+                for area_scale, height_scale in ((1.0, 1.0), (1.5, 2.0)):
+                    kwargs = dict(floor_height=floor_height, grid_size=grid_size, alert_height=alert_height,
+                                  area_scale=area_scale, height_scale=height_scale,
+                                  min_valid_collections=min_valid)
+                    expected = tuple(compute_metrics_with_grid(window, **kwargs))
+                    actual = tuple(grid.compute_metrics_with_grid(window, **kwargs))
+                    cases += 1
+                    if actual != expected:
+                        failures += 1
+                        print(f"{len(window)} collections, min_valid {min_valid}, alert {alert_height}, "
+                              f"scales {area_scale} {height_scale}: {actual} expected {expected}")
+
+    if failures > 0:
+        print(f"grid parity: {failures}/{cases} cases differ from the Python implementation")
+        return 1
+    print(f"grid parity: {cases} cases, ok")
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
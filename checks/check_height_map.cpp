@@ -0,0 +1,136 @@
+#include <stdio.h>
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include "height_map.h"
+
+/**
+ * @brief Random collection of the storage area [-length, length)^2 with piles above the
+ *        floor, points on or below it and points whose z is NaN. Its corners pin the
+ *        bounding box of computeMetrics() to the cells of the height map.
+ */
+static std::vector<double> makeCollection(std::mt19937 &rng, double length, double floor_height, size_t n)
+{
+    std::uniform_real_distribution<double> xy(-length, length);
+    std::uniform_real_distribution<double> pile(floor_height - 1.0, floor_height + 0.2);
+    std::uniform_int_distribution<int> pick(0, 99);
+
+    std::vector<double> points = {-length, -length, floor_height, length - 1e-9, length - 1e-9, floor_height + 0.5};
+    for (size_t i = 0; i < n; i++)
+    {
+        const double x = xy(rng), y = xy(rng);
+        double z = pile(rng);
+        if (pick(rng) < 2)
+        {
+            z = std::nan("");
+        }
+        else if (x > 0 && y < 0)
+        {
+            // a quadrant left mostly empty
+            z = floor_height + 0.1;
+        }
+        points.insert(points.end(), {x, y, z});
+    }
+    return points;
+}
+
+static bool sameMetrics(const GridMetrics &a, const GridMetrics &b)
+{
+    return a.volume == b.volume && a.area == b.area && a.max_height == b.max_height &&
+           a.mean_height == b.mean_height && a.quadrant == b.quadrant;
+}
+
+int main()
+{
+    const double length = 2.0;
+    const double grid_size = 0.1;
+    const double floor_height = 1.5;
+    const int window = 3;
+
+    std::mt19937 rng(3);
+    HeightMap map(length, grid_size, window);
+    std::vector<std::vector<double>> history;
+
+    size_t failures = 0;
+    for (int collection = 0; collection < 8; collection++)
+    {
+        history.push_back(makeCollection(rng, length, floor_height, 3000 + 500 * collection));
+        const std::vector<double> &points = history.back();
+
+        // the first collection is started by insert(), the others explicitly, in two halves
+        if (collection > 0)
+        {
+            map.beginCollection();
+        }
+        const size_t rows = points.size() / 3;
+        size_t inserted = map.insert(points.data(), rows / 2, 3);
+        inserted += map.insert(points.data() + (rows / 2) * 3, rows - rows / 2, 3);
+
+        std::vector<Collection> collections;
+        const size_t first = history.size() > (size_t)window ? history.size() - window : 0;
+        size_t expected_hits = 0;
+        for (size_t k = first; k < history.size(); k++)
+        {
+            collections.push_back({history[k].data(), history[k].size() / 3, 3});
+            for (size_t i = 0; i < history[k].size() / 3; i++)
+            {
+                expected_hits += !std::isnan(history[k][i * 3 + 2]);
+            }
+        }
+
+        if (map.collectionNumber() != collections.size())
+        {
+            printf("collection %d: window of %zu collections, expected %zu\n", collection, map.collectionNumber(),
+                   collections.size());
+            failures++;
+        }
+
+        std::vector<uint32_t> hits(map.gridXCount() * map.gridYCount());
+        map.hitCounts(hits.data());
+        size_t total_hits = 0;
+        for (uint32_t h : hits)
+        {
+            total_hits += h;
+        }
+        if (total_hits != expected_hits || inserted > rows)
+        {
+            printf("collection %d: %zu hits in the window, expected %zu\n", collection, total_hits, expected_hits);
+            failures++;
+        }
+
+        for (int min_valid : {0, 1, 2, 3})
+        {
+            for (double alert_height : {0.0, 0.8})
+            {
+                const GridMetrics expected =
+                    computeMetrics(collections, floor_height, grid_size, alert_height, 1.5, 2.0, min_valid);
+                const GridMetrics actual = map.computeMetrics(floor_height, alert_height, 1.5, 2.0, min_valid);
+                if (!sameMetrics(expected, actual))
+                {
+                    printf("collection %d, min_valid %d, alert %.1f: (%.17g %.17g %.17g %.17g %d) expected "
+                           "(%.17g %.17g %.17g %.17g %d)\n",
+                           collection, min_valid, alert_height, actual.volume, actual.area, actual.max_height,
+                           actual.mean_height, actual.quadrant, expected.volume, expected.area, expected.max_height,
+                           expected.mean_height, expected.quadrant);
+                    failures++;
+                }
+            }
+        }
+    }
+
+    map.clear();
+    if (map.collectionNumber() != 0 || !sameMetrics(map.computeMetrics(floor_height, 0, 1, 1, 1), GridMetrics()))
+    {
+        printf("clear() left collections in the window\n");
+        failures++;
+    }
+
+    if (failures > 0)
+    {
+        printf("height map: %zu failures against computeMetrics()\n", failures);
+        return 1;
+    }
+    printf("height map: ok\n");
+    return 0;
+}
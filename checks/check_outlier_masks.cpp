@@ -0,0 +1,228 @@
+#include <stdio.h>
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include "point_cloud_ops.h"
+
+/**
+ * @brief Clustered cloud with sparse outliers, duplicated points, a far cluster whose
+ *        cells collide with the main one's and points with a non-finite coordinate
+ */
+static std::vector<double> makeCloud(size_t n, double cell_size)
+{
+    std::mt19937 rng(5);
+    std::normal_distribution<double> cluster(0.0, 0.05);
+    std::uniform_real_distribution<double> spread(-1.0, 1.0);
+    std::uniform_int_distribution<int> pick(0, 99);
+
+    const double centers[][3] = {{0, 0, 0}, {0.4, -0.2, 0.1}, {-0.5, 0.3, -0.2}};
+    const double period = (double)(1 << 21) * cell_size * (1.0 + 1e-6);
+    std::vector<double> points;
+    while (points.size() < n * 3)
+    {
+        const int kind = pick(rng);
+        double p[3];
+        if (kind < 5 && !points.empty())
+        {
+            // exact duplicate of an earlier point
+            const size_t j = (rng() % (points.size() / 3)) * 3;
+            std::copy(points.begin() + j, points.begin() + j + 3, p);
+        }
+        else if (kind < 15)
+        {
+            for (double &v : p)
+            {
+                v = spread(rng);
+            }
+        }
+        else if (kind < 25)
+        {
+            // same cells modulo the key width as the main clusters
+            for (double &v : p)
+            {
+                v = period + cluster(rng);
+            }
+        }
+        else
+        {
+            const auto &center = centers[kind % 3];
+            for (int k = 0; k < 3; k++)
+            {
+                p[k] = center[k] + cluster(rng);
+            }
+        }
+        points.insert(points.end(), p, p + 3);
+    }
+
+    const double nan = std::nan("");
+    const double inf = std::numeric_limits<double>::infinity();
+    points[3 * 10] = nan;
+    points[3 * 20 + 1] = inf;
+    points[3 * 30 + 2] = -inf;
+    return points;
+}
+
+static bool finite(const double *p)
+{
+    return std::isfinite(p[0]) && std::isfinite(p[1]) && std::isfinite(p[2]);
+}
+
+static double distance2(const double *p, const double *q)
+{
+    const double dx = q[0] - p[0], dy = q[1] - p[1], dz = q[2] - p[2];
+    return dx * dx + dy * dy + dz * dz;
+}
+
+/**
+ * @brief open3d's remove_radius_outlier by brute force: kept if more than nb_points
+ *        active points (itself included) lie strictly within radius
+ */
+static std::vector<bool> radiusReference(const std::vector<double> &points, const std::vector<bool> &active,
+                                         int nb_points, double radius)
+{
+    const size_t n = active.size();
+    std::vector<bool> keep(n, false);
+    for (size_t i = 0; i < n; i++)
+    {
+        if (!active[i])
+        {
+            continue;
+        }
+        size_t count = 0;
+        for (size_t j = 0; j < n; j++)
+        {
+            count += active[j] && distance2(&points[i * 3], &points[j * 3]) < radius * radius;
+        }
+        keep[i] = (long)count > nb_points;
+    }
+    return keep;
+}
+
+/**
+ * @brief open3d's remove_statistical_outlier by brute force: the mean distance to the
+ *        nb_neighbors nearest finite points (itself included) against the cloud mean +
+ *        std_ratio * std, zero means being left out of the sums but not of the count
+ */
+static std::vector<bool> statisticalReference(const std::vector<double> &points, const std::vector<bool> &active,
+                                              int nb_neighbors, double std_ratio)
+{
+    const size_t n = active.size();
+    std::vector<size_t> valid_points;
+    for (size_t i = 0; i < n; i++)
+    {
+        if (active[i] && finite(&points[i * 3]))
+        {
+            valid_points.push_back(i);
+        }
+    }
+    const size_t wanted = std::min((size_t)nb_neighbors, valid_points.size());
+
+    std::vector<double> mean_distances(n, -1.0);
+    std::vector<double> d2;
+    for (size_t i : valid_points)
+    {
+        d2.clear();
+        for (size_t j : valid_points)
+        {
+            d2.push_back(distance2(&points[i * 3], &points[j * 3]));
+        }
+        std::sort(d2.begin(), d2.end());
+        double sum = 0;
+        for (size_t k = 0; k < wanted; k++)
+        {
+            sum += std::sqrt(d2[k]);
+        }
+        mean_distances[i] = sum / wanted;
+    }
+
+    double cloud_mean = 0;
+    for (size_t i : valid_points)
+    {
+        cloud_mean += mean_distances[i] > 0 ? mean_distances[i] : 0;
+    }
+    cloud_mean /= valid_points.size();
+
+    double sq_sum = 0;
+    for (size_t i : valid_points)
+    {
+        if (mean_distances[i] > 0)
+        {
+            sq_sum += (mean_distances[i] - cloud_mean) * (mean_distances[i] - cloud_mean);
+        }
+    }
+    const double threshold = cloud_mean + std_ratio * std::sqrt(sq_sum / (valid_points.size() - 1.0));
+
+    std::vector<bool> keep(n, false);
+    for (size_t i = 0; i < n; i++)
+    {
+        keep[i] = mean_distances[i] > 0 && mean_distances[i] < threshold;
+    }
+    return keep;
+}
+
+static size_t countMismatches(const char *what, const std::vector<bool> &expected, const bool *actual)
+{
+    size_t mismatches = 0;
+    for (size_t i = 0; i < expected.size(); i++)
+    {
+        if (expected[i] != actual[i] && mismatches++ < 5)
+        {
+            printf("%s: point %zu expected %d got %d\n", what, i, (int)expected[i], (int)actual[i]);
+        }
+    }
+    return mismatches;
+}
+
+int main()
+{
+    const double cell_size = 0.05;
+    const std::vector<double> points = makeCloud(2000, cell_size);
+    const size_t n = points.size() / 3;
+
+    size_t failures = 0;
+    for (int num_threads : {1, 4})
+    {
+        NeighbourIndex index(points.data(), n, cell_size, num_threads);
+        std::vector<bool> active(n, true);
+        std::unique_ptr<bool[]> mask(new bool[n]);
+
+        // radius filters of both sides of the cell size, then chained on the survivors
+        for (double radius : {0.02, 0.05, 0.12})
+        {
+            for (int nb_points : {0, 3, 16})
+            {
+                index.radiusOutlierMaskInto(nb_points, radius, mask.get());
+                failures += countMismatches("radius", radiusReference(points, active, nb_points, radius), mask.get());
+            }
+        }
+
+        for (int nb_neighbors : {1, 8, 30})
+        {
+            index.statisticalOutlierMaskInto(nb_neighbors, 1.0, mask.get());
+            failures += countMismatches("statistical", statisticalReference(points, active, nb_neighbors, 1.0),
+                                        mask.get());
+        }
+
+        index.radiusOutlierMaskInto(4, 0.05, mask.get());
+        index.selectInto(mask.get());
+        for (size_t i = 0; i < n; i++)
+        {
+            active[i] = active[i] && mask[i];
+        }
+
+        index.statisticalOutlierMaskInto(20, 2.0, mask.get());
+        failures += countMismatches("chained statistical", statisticalReference(points, active, 20, 2.0), mask.get());
+        index.radiusOutlierMaskInto(8, 0.03, mask.get());
+        failures += countMismatches("chained radius", radiusReference(points, active, 8, 0.03), mask.get());
+    }
+
+    if (failures > 0)
+    {
+        printf("outlier masks: %zu mismatches against the brute-force references\n", failures);
+        return 1;
+    }
+    printf("outlier masks: %zu points, ok\n", n);
+    return 0;
+}
@@ -0,0 +1,154 @@
+#include <stdio.h>
+#include <cmath>
+#include <random>
+#include <set>
+#include <vector>
+
+#include "spatial_grid.h"
+
+/**
+ * @brief Cloud whose cells collide after packing: clusters 2^21 cells apart along each
+ *        axis share their keys, plus a few points with a non-finite coordinate
+ */
+static std::vector<double> collidingCloud(double cell_size, size_t per_cluster)
+{
+    const double period = (double)(1 << 21) * cell_size;
+    const double offsets[][3] = {{0, 0, 0}, {period, 0, 0}, {0, -period, 0}, {0, 0, 2 * period}, {-period, period, period}};
+
+    std::mt19937 rng(11);
+    std::uniform_real_distribution<double> coord(-2.5 * cell_size, 2.5 * cell_size);
+    std::vector<double> points;
+    for (const auto &offset : offsets)
+    {
+        for (size_t i = 0; i < per_cluster; i++)
+        {
+            for (int k = 0; k < 3; k++)
+            {
+                points.push_back(offset[k] + coord(rng));
+            }
+        }
+    }
+
+    const double nan = std::nan("");
+    const double inf = std::numeric_limits<double>::infinity();
+    const double invalid[][3] = {{nan, 0, 0}, {0, inf, 0}, {0, 0, -inf}};
+    for (const auto &p : invalid)
+    {
+        points.insert(points.end(), p, p + 3);
+    }
+    return points;
+}
+
+static void cellOf(const double *p, double cell_size, int64_t c[3])
+{
+    for (int k = 0; k < 3; k++)
+    {
+        c[k] = (int64_t)std::floor(p[k] / cell_size);
+    }
+}
+
+static bool finite(const double *p)
+{
+    return std::isfinite(p[0]) && std::isfinite(p[1]) && std::isfinite(p[2]);
+}
+
+int main()
+{
+    const double cell_size = 0.25;
+    const std::vector<double> points = collidingCloud(cell_size, 200);
+    const size_t n = points.size() / 3;
+    SpatialGrid<double> grid(points.data(), n, 3, 3, cell_size);
+
+    size_t failures = 0;
+    auto fail = [&](const char *what, size_t i) {
+        if (failures++ < 10)
+        {
+            printf("point %zu: %s\n", i, what);
+        }
+    };
+
+    for (size_t i = 0; i < n; i++)
+    {
+        const double *p = &points[i * 3];
+        if (!finite(p))
+        {
+            if (grid.cellOf(i) != SpatialGrid<double>::NO_CELL)
+            {
+                fail("non-finite point bucketed", i);
+            }
+            if (grid.forEachCandidate(p, 1, [](uint32_t) {}))
+            {
+                fail("non-finite point has candidates", i);
+            }
+            continue;
+        }
+
+        // every candidate once, the brute-force neighbours among them
+        std::vector<uint32_t> candidates;
+        grid.forEachCandidate(p, 1, [&](uint32_t j) { candidates.push_back(j); });
+        const std::set<uint32_t> unique(candidates.begin(), candidates.end());
+        if (unique.size() != candidates.size())
+        {
+            fail("candidate visited twice", i);
+        }
+
+        std::set<uint32_t> shells;
+        for (int ring = 0; ring <= 1; ring++)
+        {
+            grid.forEachCellInShell(p, ring, [&](uint32_t c) {
+                for (const uint32_t *it = grid.cellBegin(c); it != grid.cellEnd(c); ++it)
+                {
+                    if (!shells.insert(*it).second)
+                    {
+                        fail("shells visit a bucket twice", i);
+                    }
+                }
+            });
+        }
+        if (shells != unique)
+        {
+            fail("shells 0 and 1 differ from the candidates within 1 ring", i);
+        }
+
+        int64_t cp[3];
+        cellOf(p, cell_size, cp);
+        bool collided = false;
+        for (size_t j = 0; j < n; j++)
+        {
+            const double *q = &points[j * 3];
+            if (!finite(q))
+            {
+                continue;
+            }
+
+            int64_t cq[3];
+            cellOf(q, cell_size, cq);
+            const bool neighbour = std::abs(cq[0] - cp[0]) <= 1 && std::abs(cq[1] - cp[1]) <= 1 &&
+                                   std::abs(cq[2] - cp[2]) <= 1;
+            const bool candidate = unique.count((uint32_t)j) > 0;
+            if (neighbour && !candidate)
+            {
+                fail("neighbour missing from the candidates", i);
+            }
+            collided = collided || (candidate && !neighbour);
+
+            const bool same = cq[0] == cp[0] && cq[1] == cp[1] && cq[2] == cp[2];
+            if (grid.sameCell(p, q) != same)
+            {
+                fail("sameCell disagrees with the cell coordinates", i);
+            }
+        }
+        if (!collided)
+        {
+            fail("no colliding candidate, the check does not exercise collisions", i);
+        }
+    }
+
+    if (failures > 0)
+    {
+        printf("spatial grid: %zu failures over %zu points\n", failures, n);
+        return 1;
+    }
+    printf("spatial grid: %zu points in %zu buckets, ok\n", n, grid.cellCount());
+    return 0;
+}
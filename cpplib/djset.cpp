@@ -1,7 +1,16 @@
 #include <pybind11/pybind11.h>
 #include <pybind11/stl.h>
 #include <pybind11/numpy.h>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
 #include <iostream>
+#include <memory>
+#include <set>
+#include <thread>
+#include <vector>
+
+#include "spatial_grid.h"
 
 namespace py = pybind11;
 
@@ -20,48 +29,24 @@ public:
         }
     }
 
-    DisjointSet(py::array_t<float> array, float unit_dist_threshold) {
+    // num_threads > 1 builds the components in parallel, each component is then represented
+    // by its smallest index; num_threads <= 0 uses every hardware thread
+    DisjointSet(py::array_t<float> array, float unit_dist_threshold, int num_threads = 1) {
         // input a 2D array, <N, M> where N is the number of points and M is the number of dimensions
-        auto buf = array.mutable_unchecked<2>();
-        uint32_t rows = buf.shape(0);
-        uint32_t cols = buf.shape(1);
-        
-        n = rows;
-        components = rows;
-
-        parent = new int[n];
-        rank = new int[n];
-        size = new int[n];
-
-        for (uint32_t i = 0; i < n; i++) {
-            parent[i] = i;
-            rank[i] = 0;
-            size[i] = 1;
+        auto points = py::array_t<float, py::array::c_style | py::array::forcecast>::ensure(array);
+        if (!points || points.ndim() != 2) {
+            throw std::runtime_error("Input array must be 2-dimensional.");
         }
+        uint32_t rows = points.shape(0);
+        uint32_t cols = points.shape(1);
 
-        for (uint32_t i = 0; i < n; i++) {
-            for (uint32_t j = i + 1; j < n; j++) {
-                float dist = 0.0f;
-
-                for (uint32_t k = 0; k < cols; k++) {
-                    float diff = buf(i, k) - buf(j, k);
-                    dist += diff * diff;
+        init(rows);
 
-                    // No need to continue if distance exceeds threshold
-                    if (dist > unit_dist_threshold * unit_dist_threshold) {
-                        break;
-                    }
-                }
-
-                // Only unite if the squared distance is within the threshold
-                if (dist <= unit_dist_threshold * unit_dist_threshold) {
-                    unite(i, j);
-                }
-            }
-        }
+        py::gil_scoped_release release;
+        uniteWithinThreshold(points.data(), cols, unit_dist_threshold, num_threads);
     }
 
-    DisjointSet(py::array_t<float> array, uint32_t rows, uint32_t cols, float unit_dist_threshold) {
+    DisjointSet(py::array_t<float> array, uint32_t rows, uint32_t cols, float unit_dist_threshold, int num_threads = 1) {
         py::buffer_info buf = array.request();
         float* ptr = (float*)buf.ptr;
 
@@ -69,39 +54,10 @@ public:
             throw std::runtime_error("Input array must be 2-dimensional and match the specified shape.");
         }
 
-        n = rows;
-        components = rows;
-
-        parent = new int[n];
-        rank = new int[n];
-        size = new int[n];
-
-        for (uint32_t i = 0; i < n; i++) {
-            parent[i] = i;
-            rank[i] = 0;
-            size[i] = 1;
-        }
-
-        for (uint32_t i = 0; i < n; i++) {
-            for (uint32_t j = i + 1; j < n; j++) {
-                float dist = 0.0f;
-
-                for (uint32_t k = 0; k < cols; k++) {
-                    float diff = ptr[i * cols + k] - ptr[j * cols + k];
-                    dist += diff * diff;
-
-                    // No need to continue if distance exceeds threshold
-                    if (dist > unit_dist_threshold * unit_dist_threshold) {
-                        break;
-                    }
-                }
+        init(rows);
 
-                // Only unite if the squared distance is within the threshold
-                if (dist <= unit_dist_threshold * unit_dist_threshold) {
-                    unite(i, j);
-                }
-            }
-        }
+        py::gil_scoped_release release;
+        uniteWithinThreshold(ptr, cols, unit_dist_threshold, num_threads);
     }
 
     ~DisjointSet() {
@@ -191,6 +147,163 @@ public:
     }
 
 private:
+    void init(uint32_t rows) {
+        n = rows;
+        components = rows;
+
+        parent = new int[n];
+        rank = new int[n];
+        size = new int[n];
+
+        for (uint32_t i = 0; i < n; i++) {
+            parent[i] = i;
+            rank[i] = 0;
+            size[i] = 1;
+        }
+    }
+
+    static bool withinThreshold(const float* a, const float* b, uint32_t cols, float unit_dist_threshold) {
+        float dist = 0.0f;
+
+        for (uint32_t k = 0; k < cols; k++) {
+            float diff = a[k] - b[k];
+            dist += diff * diff;
+
+            // No need to continue if distance exceeds threshold
+            if (dist > unit_dist_threshold * unit_dist_threshold) {
+                break;
+            }
+        }
+
+        // Only unite if the squared distance is within the threshold
+        return dist <= unit_dist_threshold * unit_dist_threshold;
+    }
+
+    // Indices j > i within unit_dist_threshold of point i, ascending
+    void neighboursAbove(const SpatialGrid<float>* grid, const float* ptr, uint32_t cols, float unit_dist_threshold,
+                         uint32_t i, std::vector<uint32_t>& neighbours) const {
+        const float* a = ptr + (size_t)i * cols;
+
+        neighbours.clear();
+        if (grid) {
+            grid->forEachCandidate(a, 1, [&](uint32_t j) {
+                if (j > i) {
+                    neighbours.push_back(j);
+                }
+            });
+            std::sort(neighbours.begin(), neighbours.end());
+        } else {
+            for (uint32_t j = i + 1; j < n; j++) {
+                neighbours.push_back(j);
+            }
+        }
+
+        neighbours.erase(std::remove_if(neighbours.begin(), neighbours.end(), [&](uint32_t j) {
+            return !withinThreshold(a, ptr + (size_t)j * cols, cols, unit_dist_threshold);
+        }), neighbours.end());
+    }
+
+    // Unite every pair of points (row-major, <n, cols>) within unit_dist_threshold
+    void uniteWithinThreshold(const float* ptr, uint32_t cols, float unit_dist_threshold, int num_threads) {
+        // Points within the threshold differ by at most one cell along every hashed axis.
+        // The cell is slightly larger than the threshold so that float rounding of the
+        // distance can never put a qualifying pair two cells apart. A zero or non-finite
+        // threshold falls back to the pair scan.
+        std::unique_ptr<SpatialGrid<float>> grid;
+        if (std::isfinite(unit_dist_threshold) && unit_dist_threshold != 0.0f) {
+            grid.reset(new SpatialGrid<float>(ptr, n, cols, (int)cols,
+                                              std::fabs((double)unit_dist_threshold) * (1.0 + 1e-4)));
+        }
+
+        if (num_threads <= 0) {
+            num_threads = std::max(1u, std::thread::hardware_concurrency());
+        }
+
+        if (num_threads == 1) {
+            // Visiting the neighbours j > i of every i in ascending order makes the sequence
+            // of unite() calls, and therefore parent/rank/size, identical to the pair scan.
+            std::vector<uint32_t> neighbours;
+            for (uint32_t i = 0; i < n; i++) {
+                neighboursAbove(grid.get(), ptr, cols, unit_dist_threshold, i, neighbours);
+                for (uint32_t j : neighbours) {
+                    unite(i, j);
+                }
+            }
+            return;
+        }
+
+        // Lock-free union-find, every link goes from the larger root to the smaller one,
+        // so parent[x] <= x always holds and the root of a component is its smallest index
+        std::unique_ptr<std::atomic<uint32_t>[]> roots(new std::atomic<uint32_t>[n]);
+        for (uint32_t i = 0; i < n; i++) {
+            roots[i].store(i, std::memory_order_relaxed);
+        }
+
+        auto findRoot = [&](uint32_t x) {
+            while (true) {
+                uint32_t p = roots[x].load(std::memory_order_relaxed);
+                if (p == x) {
+                    return x;
+                }
+                uint32_t gp = roots[p].load(std::memory_order_relaxed);
+                if (gp != p) {
+                    roots[x].compare_exchange_weak(p, gp, std::memory_order_relaxed); // path halving
+                }
+                x = gp;
+            }
+        };
+
+        auto uniteRoots = [&](uint32_t x, uint32_t y) {
+            while (true) {
+                x = findRoot(x);
+                y = findRoot(y);
+                if (x == y) {
+                    return;
+                }
+                if (x < y) {
+                    std::swap(x, y);
+                }
+                uint32_t expected = x;
+                if (roots[x].compare_exchange_strong(expected, y, std::memory_order_acq_rel)) {
+                    return;
+                }
+            }
+        };
+
+        // Edge discovery is handed out in chunks, cluster density varies a lot across a cloud
+        const uint32_t chunk = 256;
+        std::atomic<uint32_t> next(0);
+        std::vector<std::thread> workers;
+        for (int t = 0; t < num_threads; t++) {
+            workers.emplace_back([&]() {
+                std::vector<uint32_t> neighbours;
+                for (uint32_t begin = next.fetch_add(chunk); begin < n; begin = next.fetch_add(chunk)) {
+                    uint32_t end = std::min(n, begin + chunk);
+                    for (uint32_t i = begin; i < end; i++) {
+                        neighboursAbove(grid.get(), ptr, cols, unit_dist_threshold, i, neighbours);
+                        for (uint32_t j : neighbours) {
+                            uniteRoots(i, j);
+                        }
+                    }
+                }
+            });
+        }
+        for (auto& worker : workers) {
+            worker.join();
+        }
+
+        // Flatten into parent/rank/size, every tree has height at most one afterwards
+        for (uint32_t i = 0; i < n; i++) {
+            uint32_t r = findRoot(i);
+            parent[i] = r;
+            if (r != i) {
+                size[r] += size[i];
+                rank[r] = 1;
+                components--;
+            }
+        }
+    }
+
     int* parent;
     int* rank;
     int* size;
@@ -201,8 +314,10 @@ private:
 PYBIND11_MODULE(djset, m) {
     py::class_<DisjointSet>(m, "DisjointSet")
         .def(py::init<int>())
-        .def(py::init<py::array_t<float>, float>())
-        .def(py::init<py::array_t<float>, uint32_t, uint32_t, float>())
+        .def(py::init<py::array_t<float>, float, int>(),
+             py::arg("array"), py::arg("unit_dist_threshold"), py::arg("num_threads") = 1)
+        .def(py::init<py::array_t<float>, uint32_t, uint32_t, float, int>(),
+             py::arg("array"), py::arg("rows"), py::arg("cols"), py::arg("unit_dist_threshold"), py::arg("num_threads") = 1)
         .def("add_edges", &DisjointSet::add_edges)
         .def("find", &DisjointSet::find)
         .def("unite", &DisjointSet::unite)
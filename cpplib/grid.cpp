@@ -0,0 +1,115 @@
+#include <pybind11/pybind11.h>
+#include <pybind11/stl.h>
+#include <pybind11/numpy.h>
+#include <stdexcept>
+#include <vector>
+
+#include "height_map.h"
+
+namespace py = pybind11;
+
+typedef py::array_t<double, py::array::c_style | py::array::forcecast> PointArray;
+
+/**
+ * Native counterpart of pylib.utils.compute_metrics_with_grid, same arguments and results.
+ * Every collection votes the maximum height above the floor of each grid cell it covers;
+ * cells voted by at least min_valid_collections collections count with their mean height.
+ * Returns (volume, area, max_height, mean_height, quadrant).
+ */
+py::tuple computeMetricsWithGrid(py::iterable all_collections_points, double floor_height, double grid_size,
+                                 double alert_height, double area_scale, double height_scale,
+                                 int min_valid_collections) {
+    std::vector<PointArray> arrays;
+    std::vector<Collection> collections;
+    for (auto item : all_collections_points) {
+        PointArray array = PointArray::ensure(item);
+        if (!array) {
+            throw std::runtime_error("Collections must be convertible to float64 arrays.");
+        }
+        if (array.size() == 0) {
+            // Empty collection: contributes nothing
+            collections.push_back({nullptr, 0, 0});
+            continue;
+        }
+        if (array.ndim() != 2 || array.shape(1) < 3) {
+            throw std::runtime_error("Collections must be 2-dimensional arrays of shape (N, 3).");
+        }
+        collections.push_back({array.data(), (size_t)array.shape(0), (size_t)array.shape(1)});
+        arrays.push_back(array);
+    }
+
+    if (collections.empty()) {
+        return py::make_tuple(0.0, 0.0, 0.0, 0.0, 0); // volume, area, max_h, mean_h, quadrant
+    }
+    if (!(grid_size > 0.0)) {
+        throw std::invalid_argument("grid_size must be positive.");
+    }
+
+    GridMetrics metrics;
+    {
+        py::gil_scoped_release release;
+        metrics = computeMetrics(collections, floor_height, grid_size, alert_height, area_scale, height_scale,
+                                 min_valid_collections);
+    }
+    return py::make_tuple(metrics.volume, metrics.area, metrics.max_height, metrics.mean_height, metrics.quadrant);
+}
+
+// Python interface of HeightMap
+
+static HeightMap makeHeightMap(double length, double grid_size, int collections) {
+    return HeightMap(length, grid_size, collections);
+}
+
+// Add (N, 3) points to the current collection, returns the number of points inside the map
+static size_t heightMapInsert(HeightMap& map, PointArray points) {
+    if (points.size() == 0) {
+        return 0;
+    }
+    if (points.ndim() != 2 || points.shape(1) < 3) {
+        throw std::runtime_error("Points must be a 2-dimensional array of shape (N, 3).");
+    }
+
+    py::gil_scoped_release release;
+    return map.insert(points.data(), points.shape(0), points.shape(1));
+}
+
+// Metrics of the collections in the window, returns (volume, area, max_height, mean_height, quadrant)
+static py::tuple heightMapComputeMetrics(const HeightMap& map, double floor_height, double alert_height,
+                                         double area_scale, double height_scale, int min_valid_collections) {
+    if (map.collectionNumber() == 0) {
+        return py::make_tuple(0.0, 0.0, 0.0, 0.0, 0); // volume, area, max_h, mean_h, quadrant
+    }
+
+    GridMetrics metrics;
+    {
+        py::gil_scoped_release release;
+        metrics = map.computeMetrics(floor_height, alert_height, area_scale, height_scale, min_valid_collections);
+    }
+    return py::make_tuple(metrics.volume, metrics.area, metrics.max_height, metrics.mean_height, metrics.quadrant);
+}
+
+// Points of every cell summed over the window, (cells along X, cells along Y)
+static py::array_t<uint32_t> heightMapHitCounts(const HeightMap& map) {
+    py::array_t<uint32_t> counts({static_cast<py::ssize_t>(map.gridXCount()), static_cast<py::ssize_t>(map.gridYCount())});
+    map.hitCounts(counts.mutable_data());
+    return counts;
+}
+
+PYBIND11_MODULE(grid, m) {
+    m.def("compute_metrics_with_grid", &computeMetricsWithGrid,
+          py::arg("all_collections_points"), py::arg("floor_height"), py::arg("grid_size") = 0.1,
+          py::arg("alert_height") = 0.0, py::arg("area_scale") = 1.0, py::arg("height_scale") = 1.0,
+          py::arg("min_valid_collections") = 2);
+
+    py::class_<HeightMap>(m, "HeightMap")
+        .def(py::init(&makeHeightMap),
+             py::arg("length"), py::arg("grid_size") = 0.1, py::arg("collections") = 3)
+        .def("begin_collection", &HeightMap::beginCollection)
+        .def("insert", &heightMapInsert, py::arg("points"))
+        .def("clear", &HeightMap::clear)
+        .def("compute_metrics", &heightMapComputeMetrics,
+             py::arg("floor_height"), py::arg("alert_height") = 0.0, py::arg("area_scale") = 1.0,
+             py::arg("height_scale") = 1.0, py::arg("min_valid_collections") = 2)
+        .def("get_hit_counts", &heightMapHitCounts)
+        .def("get_collection_number", &HeightMap::collectionNumber);
+}
@@ -1,27 +1,102 @@
 #include <pybind11/pybind11.h>
 #include <pybind11/stl.h>
+#include <pybind11/numpy.h>
 #include <iostream>
 #include <iomanip>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
 
 #include "unitree_lidar_sdk.h"
+#include "lidar_capture.h"
+#include "point_cloud_pipeline.h"
+#include "spsc_ring.h"
+#include "udp_batch_receiver.h"
+#include "voxel_accumulator.h"
 using namespace unilidar_sdk2;
+namespace py = pybind11;
 
 typedef std::tuple<float, float, float, float, float, uint32_t> _point_t;
 
+// PointUnitree is exported to numpy as a row of 6 float32 (ring kept as raw bits)
+static_assert(sizeof(PointUnitree) == 6 * sizeof(float), "PointUnitree must be 6 packed 32-bit fields");
+
+// Point packets per frame, the cloud_scan_num the readers are initialized with
+static const int FRAME_PACKETS = 18;
+
 void hello() {
     std::cout << "Hello world!" << std::endl;
 }
 
+/**
+ * @brief Crop one point packet into the frame under construction
+ * @param[in] arrival receive time of the packet [s], see lastPacketStamp() of the readers
+ * @param[in,out] pending frame under construction, packets the number of packets in it
+ * @param[in,out] frameCount number of frames completed so far, numbers the frames
+ * @return true when FRAME_PACKETS packets are gathered, the frame is then swapped into frame
+ * @note The frame is stamped with the arrival of its first packet minus the scan period.
+ *       Its id counts the frames completed from 1, a gap is a frame dropped before it was drained.
+ */
+static bool assembleFrame(PointCloudPipeline &pipeline, const LidarPointDataPacket &packet, double arrival,
+                          PointCloudSoA &pending, int &packets, uint32_t &frameCount, PointCloudSoA &frame) {
+    const double stamp = arrival - packet.data.scan_period;
+    if (packets == 0) {
+        pending.clear();
+        pending.stamp = stamp;
+        pending.ringNum = 1;
+    }
+    pipeline.append(pending, packet, (float)(stamp - pending.stamp));
+
+    if (++packets < FRAME_PACKETS) {
+        return false;
+    }
+    packets = 0;
+    pending.id = ++frameCount;
+    std::swap(frame, pending);
+    return true;
+}
+
+/**
+ * @brief Python facing wrapper of one UnitreeLidarReader
+ *
+ * Thread-safety contract:
+ * - Every blocking method (init, start/stop/reset, work mode and address config,
+ *   version/dirty/delay queries, streaming start/stop, pipeline changes, point
+ *   cloud batches, workInLoop) runs with the GIL released, so other python
+ *   threads keep running meanwhile.
+ * - Calls into the reader are serialized by an internal mutex: control methods
+ *   may be called from any thread, also while streaming.
+ * - Point cloud batches are drained by one thread at a time, concurrent callers
+ *   are served one after the other. The same holds for IMU batches.
+ * - The init methods must complete before any other method is called and must
+ *   not race with each other.
+ * - Separate LidarManager instances share no state, so several devices can be
+ *   driven from one process, e.g. one python thread per manager.
+ */
 class LidarManager {
 public:
     LidarManager() {
         std::cout << "[System] LidarManager created!" << std::endl;
     }
     ~LidarManager() {
+        // callbacks take the GIL on the acquisition thread, never join it while holding the GIL
+        if (Py_IsInitialized() && PyGILState_Check()) {
+            py::gil_scoped_release release;
+            stopStreaming();
+        } else {
+            stopStreaming();
+        }
         std::cout << "[System] LidarManager destroyed!" << std::endl;
     }
 
-    UnitreeLidarReader *lreader;
+    UnitreeLidarReader *lreader = nullptr;
 
     void initLidarWithUDP(const std::string &lidar_ip, unsigned short lidar_port,
                           const std::string &local_ip, unsigned short local_port) {
@@ -53,20 +128,115 @@ public:
         }
     }
 
+    /**
+     * @brief Initialize the Lidar in UDP mode, reading the socket with recvmmsg
+     * @param batch most packets read per syscall
+     * @param receiveBuffer socket receive buffer requested, in bytes
+     * @param kernelTimestamps stamp the packets when they reach the socket
+     */
+    void initLidarWithBatchedUDP(const std::string &lidar_ip, unsigned short lidar_port,
+                                 const std::string &local_ip, unsigned short local_port,
+                                 size_t batch, int receiveBuffer, bool kernelTimestamps) {
+        std::unique_ptr<UdpBatchLidarReader> reader(new UdpBatchLidarReader(batch, receiveBuffer, kernelTimestamps));
+
+        std::cout << "[System] Initializing Lidar in batched UDP mode..." << std::endl;
+
+        if (reader->initializeUDP(lidar_port, lidar_ip, local_port, local_ip, FRAME_PACKETS)) {
+            throw std::runtime_error("Can not bind the UDP port " + std::to_string(local_port) + ".");
+        }
+        batchReader = std::move(reader);
+        lreader = batchReader.get();
+        std::cout << "[System] Unilidar initialization succeed! Receive buffer "
+                  << batchReader->receiver().receiveBufferSize() << " bytes, kernel timestamps "
+                  << (batchReader->receiver().kernelTimestamps() ? "on" : "off") << std::endl;
+    }
+
+    /**
+     * @brief Datagrams, recvmmsg batches, truncated and malformed datagrams of the batched reader
+     */
+    std::tuple<uint64_t, uint64_t, uint64_t, uint64_t> getReceiveStats() {
+        if (!batchReader) {
+            throw std::runtime_error("Lidar is not initialized with initLidarWithBatchedUDP.");
+        }
+        std::lock_guard<std::mutex> lock(readerMutex);
+        const UdpBatchReceiver &receiver = batchReader->receiver();
+        return std::make_tuple(receiver.datagrams(), receiver.batches(), receiver.truncated(),
+                               batchReader->malformed());
+    }
+
+    /**
+     * @brief Initialize the Lidar with a capture written by startRecording
+     * @param speed pace of the replay, 1 for real time, 0 for as fast as it is parsed
+     * @param loop play the capture again once it is over
+     */
+    void initLidarWithReplay(const std::string &path, double speed, bool loop) {
+        std::unique_ptr<ReplayLidarReader> reader(new ReplayLidarReader());
+
+        std::cout << "[System] Initializing Lidar in replay mode..." << std::endl;
+
+        if (reader->initializeReplay(path, speed, loop, FRAME_PACKETS)) {
+            throw std::runtime_error("Can not replay " + path + ", it is not a capture.");
+        }
+        replayReader = std::move(reader);
+        lreader = replayReader.get();
+        std::cout << "[System] Unilidar initialization succeed!" << std::endl;
+    }
+
+    /**
+     * @brief Record every point, IMU and version packet parsed from now on to a capture
+     * @note The packets are recorded whoever parses them, the acquisition thread included.
+     */
+    void startRecording(const std::string &path) {
+        std::lock_guard<std::mutex> lock(readerMutex);
+        if (!recorder.open(path)) {
+            throw std::runtime_error("Can not write the capture " + path + ".");
+        }
+        std::cout << "[System] Recording Lidar packets to " << path << std::endl;
+    }
+
+    /**
+     * @brief Close the capture
+     * @return number of packets recorded
+     * @note Throws if a packet could not be written or the capture could not be flushed,
+     *       the recording stopped at the failure and the capture holds the packets before it.
+     */
+    size_t stopRecording() {
+        std::lock_guard<std::mutex> lock(readerMutex);
+        const size_t records = recorder.records();
+        const bool wasOpen = recorder.isOpen();
+        if (!recorder.close()) {
+            throw std::runtime_error("The capture could not be written, it holds the first " +
+                                     std::to_string(records) + " packets only.");
+        }
+        if (wasOpen) {
+            std::cout << "[System] Recording stopped after " << records << " packets!" << std::endl;
+        }
+        return records;
+    }
+
     void stopLidar() {
-        lreader->stopLidarRotation();
+        {
+            std::lock_guard<std::mutex> lock(readerMutex);
+            lreader->stopLidarRotation();
+        }
         std::cout << "[System] Lidar stopped!" << std::endl;
         sleep(3);
     }
 
     void startLidar() {
-        lreader->startLidarRotation();
+        {
+            std::lock_guard<std::mutex> lock(readerMutex);
+            lreader->startLidarRotation();
+        }
         std::cout << "[System] Lidar started!" << std::endl;
         sleep(3);
     }
 
     void resetLidar() {
-        lreader->resetLidar();
+        {
+            std::lock_guard<std::mutex> lock(readerMutex);
+            lreader->resetLidar();
+        }
         std::cout << "[System] Lidar reset!" << std::endl;
         sleep(3);
     }
@@ -78,7 +248,10 @@ public:
         // uint32_t workMode = 12; // 0b1100, close imu, serial
         // uint32_t workMode = 28; // 0b11100
         uint32_t workMode = mode; // Use the provided mode
-        lreader->setLidarWorkMode(workMode);
+        {
+            std::lock_guard<std::mutex> lock(readerMutex);
+            lreader->setLidarWorkMode(workMode);
+        }
         std::cout << "[System] Lidar work mode set to: " << workMode << std::endl;
         sleep(3);
     }
@@ -125,7 +298,10 @@ public:
         config.subnet_mask[2] = 255;
         config.subnet_mask[3] = 0;
 
-        lreader->setLidarIpAddressConfig(config);
+        {
+            std::lock_guard<std::mutex> lock(readerMutex);
+            lreader->setLidarIpAddressConfig(config);
+        }
         std::cout << "[System] Lidar IP address is reset! Please reboot the Lidar!" << std::endl;
 
         sleep(3);
@@ -150,7 +326,10 @@ public:
         config.reserve[0] = 0;
         config.reserve[1] = 0;
 
-        lreader->setLidarMacAddressConfig(config);
+        {
+            std::lock_guard<std::mutex> lock(readerMutex);
+            lreader->setLidarMacAddressConfig(config);
+        }
         std::cout << "[System] Lidar Mac address is reset! Please reboot the Lidar!" << std::endl;
 
         sleep(3);
@@ -160,7 +339,10 @@ public:
         int result;
 
         while (true) {
-            result = lreader->runParse();
+            {
+                std::lock_guard<std::mutex> lock(readerMutex);
+                result = parseMessage();
+            }
             
             switch (result) {
                 case LIDAR_ACK_DATA_PACKET_TYPE:
@@ -201,11 +383,15 @@ public:
         std::string versionHardware;
         std::string versionFirmware;
 
-        while (!lreader->getVersionOfLidarFirmware(versionFirmware)) {
-            lreader->runParse();
+        {
+            std::unique_lock<std::mutex> lock(readerMutex);
+            while (!lreader->getVersionOfLidarFirmware(versionFirmware)) {
+                parseMessage();
+                relaxReader(lock);
+            }
+            lreader->getVersionOfLidarHardware(versionHardware);
+            lreader->getVersionOfSDK(versionSDK);
         }
-        lreader->getVersionOfLidarHardware(versionHardware);
-        lreader->getVersionOfSDK(versionSDK);
 
         std::cout << "[Data] Lidar hardware version = " << versionHardware << std::endl
                   << "[Data] Lidar firmware version = " << versionFirmware << std::endl
@@ -215,8 +401,12 @@ public:
 
     void getDirtyPercentage() {
         float dirtyPercentage;
-        while (!lreader->getDirtyPercentage(dirtyPercentage)) {
-            lreader->runParse();
+        {
+            std::unique_lock<std::mutex> lock(readerMutex);
+            while (!lreader->getDirtyPercentage(dirtyPercentage)) {
+                parseMessage();
+                relaxReader(lock);
+            }
         }
         std::cout << "[Data] Dirty percentage = " << dirtyPercentage << " %" << std::endl;
         sleep(1);
@@ -224,86 +414,1274 @@ public:
 
     void getTimeDelay() {
         double timeDelay;
-        while (!lreader->getTimeDelay(timeDelay)) {
-            lreader->runParse();
+        {
+            std::unique_lock<std::mutex> lock(readerMutex);
+            while (!lreader->getTimeDelay(timeDelay)) {
+                parseMessage();
+                relaxReader(lock);
+            }
         }
         std::cout << "[Data] Time delay (second) = " << timeDelay << std::endl;
         sleep(1);
     }
 
+    /**
+     * @brief Start a native acquisition thread which parses packets all the time
+     * @param capacity number of parsed point clouds kept until they are drained,
+     *        newer clouds are dropped (and counted) while the ring is full
+     * @param imuCapacity number of IMU samples kept until they are drained, likewise
+     * @note Frames, IMU samples and pipeline orientations left from a previous streaming
+     *       session are discarded. Waits for a batch being drained by another thread to complete.
+     */
+    void startStreaming(size_t capacity, size_t imuCapacity) {
+        if (lreader == nullptr) {
+            throw std::runtime_error("Lidar is not initialized, call initLidarWithUDP/initLidarWithSerial first.");
+        }
+        if (capacity == 0 || imuCapacity == 0) {
+            throw std::runtime_error("capacity and imuCapacity must be positive.");
+        }
+        std::lock_guard<std::mutex> consumerLock(consumerMutex);
+        if (streaming) return;
+
+        frames.reset(new SpscRing<PointCloudUnitree>(capacity));
+        pipelineFrames.reset(new SpscRing<PointCloudSoA>(capacity));
+        resetPipelineSession();
+        droppedFrames = 0;
+        {
+            std::lock_guard<std::mutex> lock(imuConsumerMutex);
+            imuSamples.reset(new SpscRing<LidarImuData>(imuCapacity));
+        }
+        droppedImu = 0;
+        pendingCloud.clear();
+        pendingFrames = 0;
+        pendingImu.clear();
+        pendingAcks = 0;
+        pendingVersion = false;
+        streaming = true;
+        streamThread = std::thread(&LidarManager::streamLoop, this);
+        std::cout << "[System] Lidar streaming started!" << std::endl;
+    }
+
+    /**
+     * @note Waits for a batch being drained by another thread to complete, such a drain
+     *       parses the rest of its batch itself once streaming is off.
+     */
+    void stopStreaming() {
+        if (!streaming) return;
+
+        streaming = false;
+        std::lock_guard<std::mutex> consumerLock(consumerMutex);
+        if (streamThread.joinable()) {
+            streamThread.join();
+        }
+        std::cout << "[System] Lidar streaming stopped!" << std::endl;
+    }
+
+    bool isStreaming() const {
+        return streaming;
+    }
+
+    uint64_t getDroppedFrames() const {
+        return droppedFrames;
+    }
+
+    uint64_t getDroppedImu() const {
+        return droppedImu;
+    }
+
+    /**
+     * @brief Drain up to batchNum IMU samples captured while streaming (0: every buffered one)
+     * @note Never blocks, samples come out in arrival order with their DataInfo stamps.
+     */
+    std::vector<LidarImuData> drainImu(size_t batchNum) {
+        std::lock_guard<std::mutex> lock(imuConsumerMutex);
+        std::vector<LidarImuData> samples;
+        if (!imuSamples) {
+            return samples;
+        }
+
+        samples.reserve(batchNum == 0 ? imuSamples->size() : std::min(batchNum, imuSamples->size()));
+        LidarImuData imu;
+        while ((batchNum == 0 || samples.size() < batchNum) && imuSamples->pop(imu)) {
+            samples.push_back(imu);
+        }
+        return samples;
+    }
+
+    /**
+     * @brief Deliver the streamed frames to callback, batchNum frames merged per call
+     * @note Callbacks run on the acquisition thread while streaming; while one is set the
+     *       frames go to it instead of the batch getters, which then throw. A partial batch
+     *       is delivered when streaming stops. An empty callback unsubscribes.
+     */
+    void subscribePointCloud(std::function<void(PointCloudSoA &)> callback, int batchNum = 1) {
+        checkSubscription(batchNum);
+        pointCloudCallback = std::move(callback);
+        pointCloudCallbackBatch = batchNum;
+    }
+
+    /**
+     * @brief Deliver the streamed IMU samples to callback, batchNum samples per call
+     */
+    void subscribeImu(std::function<void(std::vector<LidarImuData> &)> callback, int batchNum = 1) {
+        checkSubscription(batchNum);
+        imuCallback = std::move(callback);
+        imuCallbackBatch = batchNum;
+    }
+
+    /**
+     * @brief Call callback for every ACK packet the lidar sends back while streaming
+     */
+    void subscribeAck(std::function<void()> callback) {
+        checkSubscription(1);
+        ackCallback = std::move(callback);
+    }
+
+    /**
+     * @brief Call callback with the hardware and firmware versions of every version packet
+     */
+    void subscribeVersion(std::function<void(const std::string &, const std::string &)> callback) {
+        checkSubscription(1);
+        versionCallback = std::move(callback);
+    }
+
+    void clearSubscriptions() {
+        checkSubscription(1);
+        pointCloudCallback = nullptr;
+        imuCallback = nullptr;
+        ackCallback = nullptr;
+        versionCallback = nullptr;
+    }
+
+    /**
+     * @brief Enable the native acquisition pipeline
+     * @param length keep the points with |x| < length and |y| < length
+     * @param below_lidar_threshold keep the points with z > below_lidar_threshold
+     * @param deskew rotate every point into the IMU orientation at the start of its frame
+     * @note Packets are then projected and cropped while they are parsed, by the
+     *       acquisition thread when streaming, and drained with accumulatePointCloudBatch().
+     *       The point cloud batch getters are not available while streaming through it.
+     */
+    void enablePipeline(double length, double below_lidar_threshold, bool deskew) {
+        std::lock_guard<std::mutex> lock(consumerMutex);
+        if (streaming) {
+            throw std::runtime_error("The pipeline can not be changed while streaming, call stopStreaming first.");
+        }
+
+        PointCloudPipelineConfig config;
+        config.length = length;
+        config.below_lidar_threshold = below_lidar_threshold;
+        config.deskew = deskew;
+        pipeline.reset(new PointCloudPipeline(config));
+        resetPipelineSession();
+    }
+
+    void disablePipeline() {
+        std::lock_guard<std::mutex> lock(consumerMutex);
+        if (streaming) {
+            throw std::runtime_error("The pipeline can not be changed while streaming, call stopStreaming first.");
+        }
+        pipeline.reset();
+    }
+
+    bool isPipelineEnabled() const {
+        return pipeline != nullptr;
+    }
+
+    /**
+     * @brief Voxelize the cropped points of batchNum frames into voxels
+     * @return number of points accumulated
+     * @note voxels must not be used by another thread meanwhile.
+     */
+    size_t accumulatePointCloudBatch(VoxelAccumulator &voxels, int batchNum) {
+        std::lock_guard<std::mutex> lock(consumerMutex);
+        if (!pipeline) {
+            throw std::runtime_error("Pipeline is not enabled, call enablePipeline first.");
+        }
+        if (streaming && pointCloudCallback) {
+            throw std::runtime_error("Streaming to the point cloud subscriber, no frame reaches the batch getters.");
+        }
+
+        int result;
+        int count = 0;
+        size_t accumulated = 0;
+        PointCloudSoA frame;
+
+        while (count < batchNum) {
+            if (streaming) {
+                if (!pipelineFrames->pop(frame)) {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                    continue;
+                }
+            } else if (!parsePipelineFrame(frame, result)) {
+                continue;
+            }
+
+            accumulated += voxels.insertColumns(frame.x.data(), frame.y.data(), frame.z.data(),
+                                                frame.intensity.data(), frame.size());
+            count++;
+        }
+        return accumulated;
+    }
+
     std::vector<_point_t> getPointCloudBatch(int batchNum) {
+        std::vector<PointUnitree> raw;
+        {
+            py::gil_scoped_release release;
+            collectPointCloudBatch(batchNum, [&](const PointCloudUnitree &cloud) {
+                raw.insert(raw.end(), cloud.points.begin(), cloud.points.end());
+            });
+        }
+
+        std::vector<_point_t> points;
+        points.reserve(raw.size());
+        for (const auto &point : raw) {
+            // Create a tuple for each point
+            points.emplace_back(point.x, point.y, point.z, point.intensity, point.time, point.ring);
+        }
+        return points;
+    }
+
+    /**
+     * @brief Get point cloud data in batch as a (N, 6) float32 numpy array
+     * @note Columns are x, y, z, intensity, time, ring. The ring column holds the raw
+     *       uint32 bits, use `arr[:, 5].view(np.uint32)` to read it back. The array
+     *       takes over the parsed buffer, no per-point python object is created.
+     */
+    py::array_t<float> getPointCloudBatchArray(int batchNum) {
+        std::unique_ptr<std::vector<PointUnitree>> buffer(new std::vector<PointUnitree>());
+        {
+            py::gil_scoped_release release;
+            collectPointCloudBatch(batchNum, [&](const PointCloudUnitree &cloud) {
+                buffer->insert(buffer->end(), cloud.points.begin(), cloud.points.end());
+            });
+        }
+
+        auto *points = buffer.release();
+        py::capsule owner(points, [](void *p) { delete reinterpret_cast<std::vector<PointUnitree> *>(p); });
+        return py::array_t<float>(
+            {static_cast<py::ssize_t>(points->size()), static_cast<py::ssize_t>(6)},
+            {static_cast<py::ssize_t>(sizeof(PointUnitree)), static_cast<py::ssize_t>(sizeof(float))},
+            reinterpret_cast<float *>(points->data()),
+            owner);
+    }
+
+    /**
+     * @brief Get point cloud data in batch as columns, see PointCloudSoA
+     */
+    PointCloudSoA getPointCloudBatchSoA(int batchNum) {
+        PointCloudSoA points;
+        {
+            py::gil_scoped_release release;
+            collectPointCloudBatch(batchNum, [&](const PointCloudUnitree &cloud) {
+                points.append(cloud);
+            });
+        }
+        return points;
+    }
+
+private:
+    std::mutex readerMutex;   // guards lreader and recorder, runParse() is not thread safe
+    std::mutex consumerMutex; // only one thread drains the frame ring at a time
+
+    std::unique_ptr<ReplayLidarReader> replayReader; // owns lreader when replaying a capture
+    std::unique_ptr<UdpBatchLidarReader> batchReader; // owns lreader in batched UDP mode
+    LidarCaptureWriter recorder;
+    double messageStamp = 0; // receive time of the last message parsed, guarded by readerMutex
+
+    std::thread streamThread;
+    std::atomic<bool> streaming{false};
+    std::atomic<uint64_t> droppedFrames{0};
+    std::unique_ptr<SpscRing<PointCloudUnitree>> frames;
+
+    // IMU samples captured by the acquisition thread
+    std::mutex imuConsumerMutex; // only one thread drains the IMU ring at a time
+    std::unique_ptr<SpscRing<LidarImuData>> imuSamples;
+    std::atomic<uint64_t> droppedImu{0};
+
+    // native pipeline, the frame under construction is guarded by readerMutex like the reader
+    std::unique_ptr<PointCloudPipeline> pipeline;
+    std::unique_ptr<SpscRing<PointCloudSoA>> pipelineFrames;
+    PointCloudSoA pipelineFrame;
+    int pipelinePackets = 0;
+    uint32_t pipelineFrameCount = 0;
+
+    // subscriptions, set while not streaming and dispatched by the acquisition thread,
+    // the pending messages belong to that thread
+    std::function<void(PointCloudSoA &)> pointCloudCallback;
+    std::function<void(std::vector<LidarImuData> &)> imuCallback;
+    std::function<void()> ackCallback;
+    std::function<void(const std::string &, const std::string &)> versionCallback;
+    int pointCloudCallbackBatch = 1;
+    int imuCallbackBatch = 1;
+    PointCloudSoA pendingCloud;
+    int pendingFrames = 0;
+    std::vector<LidarImuData> pendingImu;
+    int pendingAcks = 0;
+    bool pendingVersion = false;
+    std::string pendingHardware, pendingFirmware;
+
+    /**
+     * @brief Parse one message from the reader, recorded when recording, readerMutex held
+     */
+    int parseMessage() {
+        const int result = lreader->runParse();
+        if (result != 0) {
+            messageStamp = lastPacketStamp();
+        }
+        if (recorder.isOpen() && !recorder.record(*lreader, result, messageStamp)) {
+            std::cout << "[System] Recording stopped, the capture can not be written!" << std::endl;
+        }
+        return result;
+    }
+
+    /**
+     * @brief Receive time of the message lreader just parsed, readerMutex held: the socket
+     *        stamp of the batched reader, the shifted recorded one of a replay and the parse time
+     *        of the SDK reader, which keeps its receive times to itself
+     */
+    double lastPacketStamp() const {
+        if (batchReader && lreader == batchReader.get()) {
+            return batchReader->lastPacketStamp();
+        }
+        if (replayReader && lreader == replayReader.get()) {
+            return replayReader->lastPacketStamp();
+        }
+        return getSystemTimeStamp();
+    }
+
+    void checkSubscription(int batchNum) {
+        if (streaming) {
+            throw std::runtime_error("Subscriptions can not be changed while streaming, call stopStreaming first.");
+        }
+        if (batchNum < 1) {
+            throw std::runtime_error("batchNum must be positive.");
+        }
+    }
+
+    /**
+     * @brief Keep the payload of the non point message just parsed for the de-skew, the
+     *        IMU ring and the subscribers, called by the parsing thread with readerMutex held
+     */
+    void captureMessage(int result) {
+        if (result == LIDAR_IMU_DATA_PACKET_TYPE && pipeline && pipeline->config().deskew) {
+            // stamped on arrival like the frames, the device clock of DataInfo is not synchronized
+            LidarImuData imu;
+            if (lreader->getImuData(imu)) {
+                pipeline->addOrientation(messageStamp, imu.quaternion);
+            }
+        }
+        if (!streaming) {
+            return;
+        }
+        if (result == LIDAR_IMU_DATA_PACKET_TYPE) {
+            LidarImuData imu;
+            if (lreader->getImuData(imu)) {
+                if (!imuSamples->push(imu)) {
+                    droppedImu++;
+                }
+                if (imuCallback) {
+                    pendingImu.push_back(imu);
+                }
+            }
+        } else if (result == LIDAR_ACK_DATA_PACKET_TYPE && ackCallback) {
+            pendingAcks++;
+        } else if (result == LIDAR_VERSION_PACKET_TYPE && versionCallback) {
+            pendingVersion = lreader->getVersionOfLidarHardware(pendingHardware) &&
+                             lreader->getVersionOfLidarFirmware(pendingFirmware);
+        }
+    }
+
+    /**
+     * @brief Run the subscribers of the captured messages, flush delivers partial batches
+     */
+    void dispatchMessages(bool flush) {
+        if (!pendingImu.empty() && (flush || pendingImu.size() >= (size_t)imuCallbackBatch)) {
+            imuCallback(pendingImu);
+            pendingImu.clear();
+        }
+        for (; pendingAcks > 0; pendingAcks--) {
+            ackCallback();
+        }
+        if (pendingVersion) {
+            pendingVersion = false;
+            versionCallback(pendingHardware, pendingFirmware);
+        }
+        if (flush && pendingFrames > 0) {
+            pointCloudCallback(pendingCloud);
+            pendingCloud = PointCloudSoA();
+            pendingFrames = 0;
+        }
+    }
+
+    /**
+     * @brief Hand a streamed frame to the point cloud subscriber or to the frame ring
+     */
+    template <typename Frame, typename Ring>
+    void deliverFrame(Frame &frame, Ring &ring) {
+        if (!pointCloudCallback) {
+            if (!ring.push(frame)) {
+                droppedFrames++;
+            }
+            return;
+        }
+
+        pendingCloud.append(frame);
+        if (++pendingFrames >= pointCloudCallbackBatch) {
+            pointCloudCallback(pendingCloud);
+            pendingCloud = PointCloudSoA();
+            pendingFrames = 0;
+        }
+    }
+
+    /**
+     * @brief Parse one message from the reader
+     * @return true if a complete point cloud is parsed into cloud
+     */
+    bool parsePointCloud(PointCloudUnitree &cloud, int &result) {
+        std::lock_guard<std::mutex> lock(readerMutex);
+        result = parseMessage();
+        captureMessage(result);
+        return result == LIDAR_POINT_DATA_PACKET_TYPE && lreader->getPointCloud(cloud);
+    }
+
+    /**
+     * @brief Drop the frame under construction and the IMU orientations of the previous session,
+     *        so that the first frames are not de-skewed with stale orientations
+     */
+    void resetPipelineSession() {
+        std::lock_guard<std::mutex> lock(readerMutex);
+        pipelinePackets = 0;
+        if (pipeline) {
+            pipeline->clearOrientations();
+        }
+    }
+
+    /**
+     * @brief Parse one message from the reader through the pipeline
+     * @return true if frame holds the cropped points of a complete frame
+     */
+    bool parsePipelineFrame(PointCloudSoA &frame, int &result) {
+        std::lock_guard<std::mutex> lock(readerMutex);
+        result = parseMessage();
+        if (result != LIDAR_POINT_DATA_PACKET_TYPE) {
+            captureMessage(result);
+            return false;
+        }
+        return assembleFrame(*pipeline, lreader->getLidarPointDataPacket(), messageStamp, pipelineFrame,
+                             pipelinePackets, pipelineFrameCount, frame);
+    }
+
+    /**
+     * @brief Briefly hand the reader over to the acquisition thread while streaming
+     */
+    void relaxReader(std::unique_lock<std::mutex> &lock) {
+        if (streaming) {
+            lock.unlock();
+            std::this_thread::yield();
+            lock.lock();
+        }
+    }
+
+    void streamLoop() {
         int result;
         PointCloudUnitree cloud;
+        PointCloudSoA frame;
+
+        while (streaming) {
+            if (pipeline) {
+                if (parsePipelineFrame(frame, result)) {
+                    deliverFrame(frame, *pipelineFrames);
+                } else if (result == 0) {
+                    // nothing buffered yet, do not spin on the reader
+                    std::this_thread::sleep_for(std::chrono::microseconds(200));
+                }
+            } else if (parsePointCloud(cloud, result)) {
+                deliverFrame(cloud, *frames);
+            } else if (result == 0) {
+                // nothing buffered yet, do not spin on the reader
+                std::this_thread::sleep_for(std::chrono::microseconds(200));
+            }
+            dispatchMessages(false);
+        }
+        dispatchMessages(true);
+    }
 
+    /**
+     * @brief Gather batchNum point clouds into sink, must be called without holding the GIL
+     * @note In streaming mode only the frames already parsed by the acquisition
+     *       thread are drained, otherwise packets are parsed on the calling thread.
+     */
+    template <typename Sink>
+    void collectPointCloudBatch(int batchNum, Sink sink) {
+        std::lock_guard<std::mutex> lock(consumerMutex);
+        if (streaming && pipeline) {
+            throw std::runtime_error("Streaming through the pipeline, use accumulatePointCloudBatch.");
+        }
+        if (streaming && pointCloudCallback) {
+            throw std::runtime_error("Streaming to the point cloud subscriber, no frame reaches the batch getters.");
+        }
+
+        int result;
         int count = 0;
-        std::vector<_point_t> points;
+        PointCloudUnitree cloud;
 
-        while (true) {
-            result = lreader->runParse();
-
-            if (result == LIDAR_POINT_DATA_PACKET_TYPE) {
-                if (lreader->getPointCloud(cloud)) {
-                    // double stamp = cloud.stamp;
-                    // uint32_t id = cloud.id;
-                    // uint32_t ringNum = cloud.ringNum;
-                    // std::vector<PointUnitree> points = cloud.points;
-
-                    // std::cout << std::fixed << std::setprecision(6);
-                    // std::cout << "[Data] Point cloud parsed with stamp: " << stamp
-                    //           << ", id: " << id
-                    //           << ", ringNum: " << ringNum
-                    //           << ", number of points: " << points.size() << std::endl;
-
-                    // // print first 5 points
-                    // for (int i = 0; i < std::min(5, static_cast<int>(points.size())); i++) {
-                    //     const PointUnitree &point = points[i];
-                    //     std::cout << "[Point " << i << "] x: " << point.x
-                    //               << ", y: " << point.y
-                    //               << ", z: " << point.z
-                    //               << ", intensity: " << point.intensity
-                    //               << ", time: " << point.time
-                    //               << ", ring: " << point.ring << std::endl;
-                    // }
-                    for (const auto &point : cloud.points) {
-                        // Create a tuple for each point
-                        _point_t p = std::make_tuple(point.x, point.y, point.z, point.intensity, point.time, point.ring);
-                        points.push_back(p);
+        while (count < batchNum) {
+            if (streaming) {
+                if (!frames->pop(cloud)) {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                    continue;
+                }
+            } else if (!parsePointCloud(cloud, result)) {
+                continue;
+            }
+
+            sink(cloud);
+            count++;
+        }
+    }
+};
+
+/**
+ * @brief Several lidars parsed by a small pool of native threads behind one frame interface
+ *
+ * Every device owns its reader, its pipeline (crop and optional de-skew) and a ring of
+ * complete frames. Worker w of startStreaming(capacity, threads) parses the devices w,
+ * w + threads, ... in turn and only sleeps once none of them had a message, so threads
+ * and memory grow with the points and not with a process per sensor. Frames are tagged
+ * with the index of their device, in the order the devices were added.
+ *
+ * Each device may carry an extrinsic calibration: its frames are then cropped in the
+ * sensor frame and moved into the shared site frame by the worker, so the frames of
+ * every device can be fused into one grid.
+ *
+ * Thread-safety contract:
+ * - Devices are added while not streaming, from one thread.
+ * - Control methods lock the reader of their device and may be called while streaming.
+ * - Frames are drained by one thread at a time, concurrent callers are served one after
+ *   the other. A drain gives up on a device silent for its timeout and returns what it
+ *   gathered when streaming stops, so a dead lidar never blocks the caller.
+ */
+class LidarFleet {
+public:
+    typedef std::pair<size_t, PointCloudSoA> TaggedFrame;
+
+    ~LidarFleet() {
+        stopStreaming();
+    }
+
+    /**
+     * @brief Initialize one more lidar in UDP mode with its own crop and de-skew settings
+     * @param batch read up to batch packets per syscall with recvmmsg, 0 for the SDK reader
+     * @return index of the device, the tag of its frames
+     */
+    size_t addDeviceUDP(const std::string &name,
+                        const std::string &lidar_ip, unsigned short lidar_port,
+                        const std::string &local_ip, unsigned short local_port,
+                        double length, double below_lidar_threshold, bool deskew, size_t batch) {
+        if (streaming) {
+            throw std::runtime_error("Devices can not be added while streaming, call stopStreaming first.");
+        }
+
+        std::unique_ptr<Device> device(new Device());
+        device->name = name;
+        if (batch > 0) {
+            device->batchReader.reset(new UdpBatchLidarReader(batch));
+            device->reader = device->batchReader.get();
+        } else {
+            device->sdkReader.reset(createUnitreeLidarReader());
+            device->reader = device->sdkReader.get();
+        }
+        if (device->reader->initializeUDP(lidar_port, lidar_ip, local_port, local_ip, FRAME_PACKETS)) {
+            // device releases the socket of its reader
+            throw std::runtime_error("Unilidar initialization failed for " + name + ".");
+        }
+
+        PointCloudPipelineConfig config;
+        config.length = length;
+        config.below_lidar_threshold = below_lidar_threshold;
+        config.deskew = deskew;
+        device->pipeline.reset(new PointCloudPipeline(config));
+
+        devices.push_back(std::move(device));
+        std::cout << "[System] Lidar " << name << " joined the fleet!" << std::endl;
+        return devices.size() - 1;
+    }
+
+    size_t size() const {
+        return devices.size();
+    }
+
+    const std::string &getName(size_t index) const {
+        return device(index).name;
+    }
+
+    /**
+     * @brief Set the sensor to site transform of a device, a row-major 4x4 rigid transform
+     * @note The rotation must be orthonormal with determinant 1 up to 1e-3, enough for
+     *       matrices written with a few decimals but not for a scale, shear or reflection.
+     */
+    void setExtrinsic(size_t index, const double matrix[16]) {
+        if (streaming) {
+            throw std::runtime_error("Extrinsics can not be changed while streaming, call stopStreaming first.");
+        }
+        Device &d = device(index);
+        if (std::fabs(matrix[12]) > 1e-9 || std::fabs(matrix[13]) > 1e-9 || std::fabs(matrix[14]) > 1e-9 ||
+            std::fabs(matrix[15] - 1) > 1e-9) {
+            throw std::runtime_error("The extrinsic of " + d.name + " must end with the row [0, 0, 0, 1].");
+        }
+
+        // R^T R = I, columns i and j of R are matrix[4 * k + i] and matrix[4 * k + j]
+        const double tolerance = 1e-3;
+        for (int i = 0; i < 3; i++) {
+            for (int j = 0; j < 3; j++) {
+                const double dot =
+                    matrix[i] * matrix[j] + matrix[4 + i] * matrix[4 + j] + matrix[8 + i] * matrix[8 + j];
+                if (!(std::fabs(dot - (i == j ? 1.0 : 0.0)) <= tolerance)) {
+                    throw std::runtime_error("The rotation of the extrinsic of " + d.name + " is not orthonormal.");
+                }
+            }
+        }
+        const double det = matrix[0] * (matrix[5] * matrix[10] - matrix[6] * matrix[9]) -
+                           matrix[1] * (matrix[4] * matrix[10] - matrix[6] * matrix[8]) +
+                           matrix[2] * (matrix[4] * matrix[9] - matrix[5] * matrix[8]);
+        if (!(std::fabs(det - 1.0) <= tolerance)) {
+            throw std::runtime_error("The rotation of the extrinsic of " + d.name + " is a reflection.");
+        }
+        if (!std::isfinite(matrix[3]) || !std::isfinite(matrix[7]) || !std::isfinite(matrix[11])) {
+            throw std::runtime_error("The translation of the extrinsic of " + d.name + " must be finite.");
+        }
+
+        for (int k = 0; k < 12; k++) {
+            d.extrinsic[k] = (float)matrix[k];
+        }
+        d.calibrated = true;
+    }
+
+    void startLidar(size_t index) {
+        Device &d = device(index);
+        {
+            std::lock_guard<std::mutex> lock(d.readerMutex);
+            d.reader->startLidarRotation();
+        }
+        std::cout << "[System] Lidar " << d.name << " started!" << std::endl;
+        sleep(3);
+    }
+
+    void stopLidar(size_t index) {
+        Device &d = device(index);
+        {
+            std::lock_guard<std::mutex> lock(d.readerMutex);
+            d.reader->stopLidarRotation();
+        }
+        std::cout << "[System] Lidar " << d.name << " stopped!" << std::endl;
+        sleep(3);
+    }
+
+    /**
+     * @brief Start the worker threads parsing every device
+     * @param capacity number of frames kept per device until they are drained, newer
+     *        frames are dropped (and counted) while the ring of their device is full
+     * @param threads number of workers, at most one per device, <= 0 for one per device
+     * @note Waits for a batch being drained by another thread to complete.
+     */
+    void startStreaming(size_t capacity, int threads) {
+        if (devices.empty()) {
+            throw std::runtime_error("The fleet has no device, call addDeviceUDP first.");
+        }
+        if (capacity == 0) {
+            throw std::runtime_error("capacity must be positive.");
+        }
+        std::lock_guard<std::mutex> consumerLock(consumerMutex);
+        if (streaming) return;
+
+        for (auto &d : devices) {
+            d->frames.reset(new SpscRing<PointCloudSoA>(capacity));
+            d->dropped = 0;
+            d->packets = 0;
+            d->pipeline->clearOrientations();
+        }
+
+        const size_t workers = threads <= 0 ? devices.size() : std::min((size_t)threads, devices.size());
+        streaming = true;
+        for (size_t w = 0; w < workers; w++) {
+            workerThreads.emplace_back(&LidarFleet::workerLoop, this, w, workers);
+        }
+        std::cout << "[System] Lidar fleet streaming started with " << workers << " thread(s)!" << std::endl;
+    }
+
+    /**
+     * @note Waits for a batch being drained by another thread to return what it gathered.
+     */
+    void stopStreaming() {
+        if (!streaming) return;
+
+        streaming = false;
+        std::lock_guard<std::mutex> consumerLock(consumerMutex);
+        for (auto &t : workerThreads) {
+            t.join();
+        }
+        workerThreads.clear();
+        std::cout << "[System] Lidar fleet streaming stopped!" << std::endl;
+    }
+
+    bool isStreaming() const {
+        return streaming;
+    }
+
+    uint64_t getDroppedFrames(size_t index) const {
+        return device(index).dropped;
+    }
+
+    /**
+     * @brief Wait for batchNum frames from any device, taken in turn from every device
+     * @param timeout seconds without a frame from any device after which the frames
+     *        gathered so far are returned, like when streaming stops meanwhile
+     */
+    std::vector<TaggedFrame> getFrameBatch(int batchNum, double timeout) {
+        std::lock_guard<std::mutex> lock(consumerMutex);
+        checkStreaming();
+        checkTimeout(timeout);
+
+        std::vector<TaggedFrame> batch;
+        PointCloudSoA frame;
+        Clock::time_point lastFrame = Clock::now();
+        while ((int)batch.size() < batchNum && streaming) {
+            bool found = false;
+            for (size_t k = 0; k < devices.size() && (int)batch.size() < batchNum; k++) {
+                const size_t index = nextDevice;
+                nextDevice = (nextDevice + 1) % devices.size();
+                if (devices[index]->frames->pop(frame)) {
+                    batch.emplace_back(index, std::move(frame));
+                    frame = PointCloudSoA();
+                    found = true;
+                }
+            }
+            if (found) {
+                lastFrame = Clock::now();
+            } else if (silentFor(lastFrame, timeout)) {
+                std::cout << "[System] No Lidar of the fleet delivered a frame for " << timeout << " s, "
+                          << batch.size() << " of " << batchNum << " frames gathered!" << std::endl;
+                break;
+            } else {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+        }
+        return batch;
+    }
+
+    /**
+     * @brief Voxelize batchNum frames of every device into voxels, one grid for the whole site
+     * @param timeout seconds without a frame after which a device is given up for this batch
+     * @return number of points accumulated
+     * @note voxels must not be used by another thread meanwhile. Devices which are done
+     *       keep buffering while the slower ones catch up. The frames gathered so far are
+     *       kept when streaming stops meanwhile.
+     */
+    size_t accumulatePointCloudBatch(VoxelAccumulator &voxels, int batchNum, double timeout) {
+        std::lock_guard<std::mutex> lock(consumerMutex);
+        checkStreaming();
+        checkTimeout(timeout);
+
+        std::vector<int> counts(devices.size(), 0);
+        std::vector<bool> waiting(devices.size(), batchNum > 0);
+        std::vector<Clock::time_point> lastFrames(devices.size(), Clock::now());
+        size_t done = batchNum > 0 ? 0 : devices.size();
+        size_t accumulated = 0;
+        PointCloudSoA frame;
+        while (done < devices.size() && streaming) {
+            bool found = false;
+            for (size_t i = 0; i < devices.size(); i++) {
+                if (!waiting[i]) {
+                    continue;
+                }
+                if (!devices[i]->frames->pop(frame)) {
+                    if (silentFor(lastFrames[i], timeout)) {
+                        std::cout << "[System] Lidar " << devices[i]->name << " delivered no frame for " << timeout
+                                  << " s, " << counts[i] << " of " << batchNum << " frames accumulated!" << std::endl;
+                        waiting[i] = false;
+                        done++;
                     }
-                    
-                    // std::cout << "[Data] Processed " << count << " batches of point cloud data." << std::endl;
-                    // std::cout << "[Data] Current batch size: " << points.size() << std::endl;
-                    
-                    count++;
+                    continue;
+                }
+
+                accumulated += voxels.insertColumns(frame.x.data(), frame.y.data(), frame.z.data(),
+                                                    frame.intensity.data(), frame.size());
+                found = true;
+                lastFrames[i] = Clock::now();
+                if (++counts[i] == batchNum) {
+                    waiting[i] = false;
+                    done++;
+                }
+            }
+            if (!found) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+        }
+        return accumulated;
+    }
+
+    /**
+     * @brief Voxelize the cropped points of batchNum frames of one device into voxels
+     * @param timeout seconds without a frame of the device after which the frames
+     *        gathered so far are kept, like when streaming stops meanwhile
+     * @return number of points accumulated
+     * @note voxels must not be used by another thread meanwhile.
+     */
+    size_t accumulatePointCloudBatch(size_t index, VoxelAccumulator &voxels, int batchNum, double timeout) {
+        std::lock_guard<std::mutex> lock(consumerMutex);
+        checkStreaming();
+        checkTimeout(timeout);
+
+        Device &d = device(index);
+        int count = 0;
+        size_t accumulated = 0;
+        PointCloudSoA frame;
+        Clock::time_point lastFrame = Clock::now();
+        while (count < batchNum && streaming) {
+            if (!d.frames->pop(frame)) {
+                if (silentFor(lastFrame, timeout)) {
+                    std::cout << "[System] Lidar " << d.name << " delivered no frame for " << timeout << " s, "
+                              << count << " of " << batchNum << " frames accumulated!" << std::endl;
+                    break;
                 }
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                continue;
             }
 
-            if (count >= batchNum) break;
+            accumulated += voxels.insertColumns(frame.x.data(), frame.y.data(), frame.z.data(),
+                                                frame.intensity.data(), frame.size());
+            lastFrame = Clock::now();
+            count++;
         }
+        return accumulated;
+    }
 
-        return points;
+private:
+    /**
+     * @brief Deleter of the readers of createUnitreeLidarReader(): the SDK interface has no
+     *        virtual destructor, closeUDP() is what releases their socket
+     */
+    struct SdkReaderCloser {
+        void operator()(UnitreeLidarReader *reader) const {
+            reader->closeUDP();
+        }
+    };
+
+    struct Device {
+        std::string name;
+        std::mutex readerMutex; // guards reader, runParse() is not thread safe
+        UnitreeLidarReader *reader = nullptr;
+        std::unique_ptr<UdpBatchLidarReader> batchReader; // owns reader when batched
+        std::unique_ptr<UnitreeLidarReader, SdkReaderCloser> sdkReader; // owns reader otherwise
+        std::unique_ptr<PointCloudPipeline> pipeline;
+        std::unique_ptr<SpscRing<PointCloudSoA>> frames;
+        std::atomic<uint64_t> dropped{0};
+        float extrinsic[12] = {1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0}; // sensor to site, row-major [R | t]
+        bool calibrated = false;
+
+        // frame under construction, belongs to the worker of the device
+        PointCloudSoA pending;
+        int packets = 0;
+        uint32_t frameCount = 0;
+    };
+
+    typedef std::chrono::steady_clock Clock;
+
+    std::vector<std::unique_ptr<Device>> devices;
+    std::vector<std::thread> workerThreads;
+    std::atomic<bool> streaming{false};
+
+    std::mutex consumerMutex; // only one thread drains the frame rings at a time
+    size_t nextDevice = 0;    // first ring polled by the next drain
+
+    Device &device(size_t index) const {
+        if (index >= devices.size()) {
+            throw std::out_of_range("No such device in the fleet.");
+        }
+        return *devices[index];
+    }
+
+    void checkStreaming() const {
+        if (!streaming) {
+            throw std::runtime_error("The fleet is not streaming, call startStreaming first.");
+        }
+    }
+
+    static void checkTimeout(double timeout) {
+        if (!(timeout > 0)) {
+            throw std::runtime_error("timeout must be positive.");
+        }
+    }
+
+    static bool silentFor(Clock::time_point lastFrame, double timeout) {
+        return std::chrono::duration<double>(Clock::now() - lastFrame).count() > timeout;
+    }
+
+    /**
+     * @brief Receive time of the message d.reader just parsed, d.readerMutex held: the
+     *        socket stamp of the batched reader, the parse time of the SDK reader
+     */
+    static double lastPacketStamp(const Device &d) {
+        return d.batchReader ? d.batchReader->lastPacketStamp() : getSystemTimeStamp();
+    }
+
+    /**
+     * @brief Parse one message of a device, push the frame it completes if any
+     * @return false if nothing was buffered for the device
+     */
+    bool parseDevice(Device &d, PointCloudSoA &frame) {
+        LidarPointDataPacket packet;
+        double arrival;
+        {
+            std::lock_guard<std::mutex> lock(d.readerMutex);
+            const int result = d.reader->runParse();
+            if (result == 0) {
+                return false;
+            }
+            arrival = lastPacketStamp(d);
+            if (result == LIDAR_IMU_DATA_PACKET_TYPE && d.pipeline->config().deskew) {
+                LidarImuData imu;
+                if (d.reader->getImuData(imu)) {
+                    d.pipeline->addOrientation(arrival, imu.quaternion);
+                }
+            }
+            if (result != LIDAR_POINT_DATA_PACKET_TYPE) {
+                return true;
+            }
+            packet = d.reader->getLidarPointDataPacket();
+        }
+
+        if (!assembleFrame(*d.pipeline, packet, arrival, d.pending, d.packets, d.frameCount, frame)) {
+            return true;
+        }
+        if (d.calibrated) {
+            transformPoints(d.extrinsic, frame.x.data(), frame.y.data(), frame.z.data(), frame.size());
+        }
+        if (!d.frames->push(frame)) {
+            d.dropped++;
+        }
+        return true;
+    }
+
+    void workerLoop(size_t first, size_t step) {
+        PointCloudSoA frame;
+        while (streaming) {
+            bool idle = true;
+            for (size_t i = first; i < devices.size(); i += step) {
+                if (parseDevice(*devices[i], frame)) {
+                    idle = false;
+                }
+            }
+            if (idle) {
+                // nothing buffered yet, do not spin on the readers
+                std::this_thread::sleep_for(std::chrono::microseconds(200));
+            }
+        }
     }
 };
 
 
+/**
+ * @brief Numpy view of a column, owner keeps the column alive
+ */
+template <typename T>
+py::array_t<T> columnView(py::object owner, AlignedVector<T> &column) {
+    return py::array_t<T>(static_cast<py::ssize_t>(column.size()), column.data(), owner);
+}
+
+/**
+ * @brief IMU samples as an (N, 10) float64 array: quaternion, angular velocity, linear acceleration
+ */
+py::array_t<double> imuArray(const std::vector<LidarImuData> &samples) {
+    py::array_t<double> data({static_cast<py::ssize_t>(samples.size()), static_cast<py::ssize_t>(10)});
+    double *out = data.mutable_data();
+    for (const LidarImuData &imu : samples) {
+        out = std::copy(imu.quaternion, imu.quaternion + 4, out);
+        out = std::copy(imu.angular_velocity, imu.angular_velocity + 3, out);
+        out = std::copy(imu.linear_acceleration, imu.linear_acceleration + 3, out);
+    }
+    return data;
+}
+
+/**
+ * @brief DataInfo stamps of IMU samples in seconds, (N,) float64
+ */
+py::array_t<double> imuStamps(const std::vector<LidarImuData> &samples) {
+    py::array_t<double> stamps(static_cast<py::ssize_t>(samples.size()));
+    double *out = stamps.mutable_data();
+    for (const LidarImuData &imu : samples) {
+        *out++ = imu.info.stamp.sec + imu.info.stamp.nsec * 1e-9;
+    }
+    return stamps;
+}
+
+/**
+ * @brief Python callable run from a native thread
+ * @note The GIL is taken for every call and python exceptions are reported as unraisable
+ *       instead of unwinding the calling thread. The callable is released under the GIL
+ *       whichever thread drops the last copy.
+ */
+class PythonCallback {
+public:
+    explicit PythonCallback(py::function fn)
+        : fn_(new py::function(std::move(fn)), [](py::function *f) {
+              py::gil_scoped_acquire gil;
+              delete f;
+          }) {}
+
+    template <typename Make>
+    void operator()(Make makeArgs) const {
+        py::gil_scoped_acquire gil;
+        try {
+            py::tuple args = makeArgs();
+            (*fn_)(*args);
+        } catch (py::error_already_set &e) {
+            e.discard_as_unraisable("LidarManager callback");
+        }
+    }
+
+private:
+    std::shared_ptr<py::function> fn_;
+};
+
 PYBIND11_MODULE(lidar, m) {
     m.doc() = "Pybind11 module for Unitree Lidar SDK";
     m.def("hello", &hello, "Hello world from Unitree Lidar SDK!!!");
 
+    pybind11::class_<PointCloudSoA>(m, "PointCloudSoA")
+        .def(pybind11::init<>())
+        .def_readonly("stamp", &PointCloudSoA::stamp, "Cloud start timestamp")
+        .def_readonly("id", &PointCloudSoA::id, "Sequence id")
+        .def_readonly("ringNum", &PointCloudSoA::ringNum, "Number of rings")
+        .def_property_readonly("x", [](py::object self) { return columnView(self, self.cast<PointCloudSoA &>().x); },
+                               "x column, float32 numpy view without copy")
+        .def_property_readonly("y", [](py::object self) { return columnView(self, self.cast<PointCloudSoA &>().y); },
+                               "y column, float32 numpy view without copy")
+        .def_property_readonly("z", [](py::object self) { return columnView(self, self.cast<PointCloudSoA &>().z); },
+                               "z column, float32 numpy view without copy")
+        .def_property_readonly("intensity", [](py::object self) { return columnView(self, self.cast<PointCloudSoA &>().intensity); },
+                               "Intensity column, float32 numpy view without copy")
+        .def_property_readonly("time", [](py::object self) { return columnView(self, self.cast<PointCloudSoA &>().time); },
+                               "Relative time column, float32 numpy view without copy")
+        .def_property_readonly("ring", [](py::object self) { return columnView(self, self.cast<PointCloudSoA &>().ring); },
+                               "Ring column, uint32 numpy view without copy")
+        .def("xyz", [](const PointCloudSoA &cloud) {
+                 py::array_t<double> xyz({static_cast<py::ssize_t>(cloud.size()), static_cast<py::ssize_t>(3)});
+                 auto buf = xyz.mutable_unchecked<2>();
+                 for (size_t i = 0; i < cloud.size(); i++) {
+                     buf(i, 0) = cloud.x[i];
+                     buf(i, 1) = cloud.y[i];
+                     buf(i, 2) = cloud.z[i];
+                 }
+                 return xyz;
+             }, "Coordinates as a contiguous (N, 3) float64 array, ready for open3d")
+        .def("__len__", &PointCloudSoA::size);
+
+    pybind11::class_<VoxelAccumulator>(m, "VoxelAccumulator")
+        .def(pybind11::init<double>(), pybind11::arg("voxel_size") = 0.02)
+        .def_property_readonly("voxelSize", &VoxelAccumulator::voxelSize, "Voxel side length")
+        .def("insert", [](VoxelAccumulator &acc, const PointCloudSoA &cloud) {
+                 return acc.insertColumns(cloud.x.data(), cloud.y.data(), cloud.z.data(), cloud.intensity.data(), cloud.size());
+             }, pybind11::arg("cloud"), "Accumulate a PointCloudSoA, returns the number of points accumulated")
+        .def("insert", [](VoxelAccumulator &acc, py::array_t<double, py::array::c_style | py::array::forcecast> xyz,
+                          py::object intensity) {
+                 if (xyz.ndim() != 2 || xyz.shape(1) < 3) {
+                     throw std::runtime_error("xyz must be a 2-dimensional array of shape (N, 3).");
+                 }
+                 if (intensity.is_none()) {
+                     return acc.insertRows(xyz.data(), xyz.shape(1), (const double *)nullptr, xyz.shape(0));
+                 }
+                 auto values = py::array_t<double, py::array::c_style | py::array::forcecast>::ensure(intensity);
+                 if (!values || values.ndim() != 1 || values.shape(0) != xyz.shape(0)) {
+                     throw std::runtime_error("intensity must be a 1-dimensional array with one value per point.");
+                 }
+                 return acc.insertRows(xyz.data(), xyz.shape(1), values.data(), xyz.shape(0));
+             }, pybind11::arg("xyz"), pybind11::arg("intensity") = py::none(),
+             "Accumulate (N, 3) points and optional (N,) intensities, returns the number of points accumulated")
+        .def("getPoints", [](const VoxelAccumulator &acc) {
+                 py::array_t<double> points({static_cast<py::ssize_t>(acc.size()), static_cast<py::ssize_t>(3)});
+                 acc.centroids(points.mutable_data());
+                 return points;
+             }, "Voxel centroids as a contiguous (M, 3) float64 array, ready for open3d")
+        .def("getIntensity", [](const VoxelAccumulator &acc) {
+                 py::array_t<double> intensity(static_cast<py::ssize_t>(acc.size()));
+                 acc.intensities(intensity.mutable_data());
+                 return intensity;
+             }, "Mean intensity of every voxel as a (M,) float64 array")
+        .def("pointCount", &VoxelAccumulator::pointCount, "Number of points accumulated so far")
+        .def("clear", &VoxelAccumulator::clear, "Drop every voxel")
+        .def("__len__", &VoxelAccumulator::size);
+
     pybind11::class_<LidarManager>(m, "LidarManager")
         .def(pybind11::init<>())
-        .def("initLidarWithUDP", &LidarManager::initLidarWithUDP, "Initialize the Lidar with UDP")
-        .def("initLidarWithSerial", &LidarManager::initLidarWithSerial, "Initialize the Lidar with Serial")
-        .def("stopLidar", &LidarManager::stopLidar, "Stop the Lidar rotation")
-        .def("startLidar", &LidarManager::startLidar, "Start the Lidar rotation")
-        .def("resetLidar", &LidarManager::resetLidar, "Reset the Lidar")
-        .def("setWorkMode", &LidarManager::setWorkMode, "Set the Lidar work mode")
-        .def("setLidarIPPort", &LidarManager::setLidarIPPort, "Set the Lidar IP address and port")
-        .def("setLidarMac", &LidarManager::setLidarMac, "Set the Lidar MAC address")
-
-        .def("getVersion", &LidarManager::getVersion, "Get the Lidar version")
-        .def("getDirtyPercentage", &LidarManager::getDirtyPercentage, "Get the dirty percentage of the Lidar")
-        .def("getTimeDelay", &LidarManager::getTimeDelay, "Get the time delay of the Lidar")
+        .def("initLidarWithUDP", &LidarManager::initLidarWithUDP, "Initialize the Lidar with UDP",
+             pybind11::call_guard<pybind11::gil_scoped_release>())
+        .def("initLidarWithSerial", &LidarManager::initLidarWithSerial, "Initialize the Lidar with Serial",
+             pybind11::call_guard<pybind11::gil_scoped_release>())
+        .def("initLidarWithBatchedUDP", &LidarManager::initLidarWithBatchedUDP,
+             "Initialize the Lidar with UDP, reading up to batch packets per syscall",
+             pybind11::arg("lidar_ip"), pybind11::arg("lidar_port"), pybind11::arg("local_ip"),
+             pybind11::arg("local_port"), pybind11::arg("batch") = 64, pybind11::arg("receiveBuffer") = 8 << 20,
+             pybind11::arg("kernelTimestamps") = true, pybind11::call_guard<pybind11::gil_scoped_release>())
+        .def("getReceiveStats", &LidarManager::getReceiveStats,
+             "Datagrams, batches, truncated and malformed datagrams received in batched UDP mode",
+             pybind11::call_guard<pybind11::gil_scoped_release>())
+        .def("initLidarWithReplay", &LidarManager::initLidarWithReplay,
+             "Initialize the Lidar with a capture, speed 1 replays in real time and 0 as fast as possible",
+             pybind11::arg("path"), pybind11::arg("speed") = 1.0, pybind11::arg("loop") = false,
+             pybind11::call_guard<pybind11::gil_scoped_release>())
+        .def("startRecording", &LidarManager::startRecording, "Record the parsed packets to a capture file",
+             pybind11::arg("path"), pybind11::call_guard<pybind11::gil_scoped_release>())
+        .def("stopRecording", &LidarManager::stopRecording,
+             "Close the capture, returns the number of packets recorded, raises if it could not be written",
+             pybind11::call_guard<pybind11::gil_scoped_release>())
+        .def("stopLidar", &LidarManager::stopLidar, "Stop the Lidar rotation",
+             pybind11::call_guard<pybind11::gil_scoped_release>())
+        .def("startLidar", &LidarManager::startLidar, "Start the Lidar rotation",
+             pybind11::call_guard<pybind11::gil_scoped_release>())
+        .def("resetLidar", &LidarManager::resetLidar, "Reset the Lidar",
+             pybind11::call_guard<pybind11::gil_scoped_release>())
+        .def("setWorkMode", &LidarManager::setWorkMode, "Set the Lidar work mode",
+             pybind11::call_guard<pybind11::gil_scoped_release>())
+        .def("setLidarIPPort", &LidarManager::setLidarIPPort, "Set the Lidar IP address and port",
+             pybind11::call_guard<pybind11::gil_scoped_release>())
+        .def("setLidarMac", &LidarManager::setLidarMac, "Set the Lidar MAC address",
+             pybind11::call_guard<pybind11::gil_scoped_release>())
+
+        .def("getVersion", &LidarManager::getVersion, "Get the Lidar version",
+             pybind11::call_guard<pybind11::gil_scoped_release>())
+        .def("getDirtyPercentage", &LidarManager::getDirtyPercentage, "Get the dirty percentage of the Lidar",
+             pybind11::call_guard<pybind11::gil_scoped_release>())
+        .def("getTimeDelay", &LidarManager::getTimeDelay, "Get the time delay of the Lidar",
+             pybind11::call_guard<pybind11::gil_scoped_release>())
+        .def("startStreaming", &LidarManager::startStreaming, "Start parsing packets on a native acquisition thread",
+             pybind11::arg("capacity") = 64, pybind11::arg("imuCapacity") = 4096,
+             pybind11::call_guard<pybind11::gil_scoped_release>())
+        .def("stopStreaming", &LidarManager::stopStreaming, "Stop the native acquisition thread",
+             pybind11::call_guard<pybind11::gil_scoped_release>())
+        .def("isStreaming", &LidarManager::isStreaming, "Whether the acquisition thread is running")
+        .def("getDroppedFrames", &LidarManager::getDroppedFrames, "Number of point clouds dropped while the frame ring was full")
+        .def("getDroppedImu", &LidarManager::getDroppedImu, "Number of IMU samples dropped while the IMU ring was full")
+        .def("getImuBatch", [](LidarManager &manager, size_t batchNum) {
+                 return imuArray(manager.drainImu(batchNum));
+             }, "Drain up to batchNum streamed IMU samples (0: all buffered) as an (N, 10) float64 array of "
+                "quaternion, angular velocity and linear acceleration, never blocks",
+             pybind11::arg("batchNum") = 0)
+        .def("getImuBatchStamped", [](LidarManager &manager, size_t batchNum) {
+                 const std::vector<LidarImuData> samples = manager.drainImu(batchNum);
+                 return py::make_tuple(imuStamps(samples), imuArray(samples));
+             }, "Like getImuBatch, returns (stamps (N,), imu (N, 10)) with the DataInfo stamps in seconds",
+             pybind11::arg("batchNum") = 0)
+        .def("enablePipeline", &LidarManager::enablePipeline, "Crop the points natively while packets are parsed",
+             pybind11::arg("length"), pybind11::arg("below_lidar_threshold"), pybind11::arg("deskew") = false,
+             pybind11::call_guard<pybind11::gil_scoped_release>())
+        .def("disablePipeline", &LidarManager::disablePipeline, "Disable the native acquisition pipeline",
+             pybind11::call_guard<pybind11::gil_scoped_release>())
+        .def("isPipelineEnabled", &LidarManager::isPipelineEnabled, "Whether the native acquisition pipeline is enabled")
+        .def("accumulatePointCloudBatch", &LidarManager::accumulatePointCloudBatch,
+             "Voxelize the cropped points of a batch of frames into a VoxelAccumulator",
+             pybind11::arg("voxels"), pybind11::arg("batchNum"),
+             pybind11::call_guard<pybind11::gil_scoped_release>())
         .def("getPointCloudBatch", &LidarManager::getPointCloudBatch, "Get point cloud data in batch")
+        .def("getPointCloudBatchArray", &LidarManager::getPointCloudBatchArray, "Get point cloud data in batch as a (N, 6) float32 numpy array")
+        .def("getPointCloudBatchSoA", &LidarManager::getPointCloudBatchSoA, "Get point cloud data in batch as a PointCloudSoA")
+
+        .def("setPointCloudCallback", [](LidarManager &manager, py::object callback, int batchNum) {
+                 if (callback.is_none()) {
+                     manager.subscribePointCloud(nullptr, batchNum);
+                     return;
+                 }
+                 PythonCallback call(callback.cast<py::function>());
+                 manager.subscribePointCloud([call](PointCloudSoA &batch) {
+                     call([&]() { return py::make_tuple(std::move(batch)); });
+                 }, batchNum);
+             }, "Call callback(PointCloudSoA) from the acquisition thread with every batchNum streamed frames, None unsubscribes",
+             pybind11::arg("callback"), pybind11::arg("batchNum") = 1)
+        .def("setImuCallback", [](LidarManager &manager, py::object callback, int batchNum) {
+                 if (callback.is_none()) {
+                     manager.subscribeImu(nullptr, batchNum);
+                     return;
+                 }
+                 PythonCallback call(callback.cast<py::function>());
+                 manager.subscribeImu([call](std::vector<LidarImuData> &samples) {
+                     call([&]() { return py::make_tuple(imuStamps(samples), imuArray(samples)); });
+                 }, batchNum);
+             }, "Call callback(stamps (N,), imu (N, 10)) from the acquisition thread with every batchNum streamed IMU samples, None unsubscribes",
+             pybind11::arg("callback"), pybind11::arg("batchNum") = 1)
+        .def("setAckCallback", [](LidarManager &manager, py::object callback) {
+                 if (callback.is_none()) {
+                     manager.subscribeAck(nullptr);
+                     return;
+                 }
+                 PythonCallback call(callback.cast<py::function>());
+                 manager.subscribeAck([call]() { call([]() { return py::make_tuple(); }); });
+             }, "Call callback() from the acquisition thread for every ACK packet, None unsubscribes",
+             pybind11::arg("callback"))
+        .def("setVersionCallback", [](LidarManager &manager, py::object callback) {
+                 if (callback.is_none()) {
+                     manager.subscribeVersion(nullptr);
+                     return;
+                 }
+                 PythonCallback call(callback.cast<py::function>());
+                 manager.subscribeVersion([call](const std::string &hardware, const std::string &firmware) {
+                     call([&]() { return py::make_tuple(hardware, firmware); });
+                 });
+             }, "Call callback(hardware, firmware) from the acquisition thread for every version packet, None unsubscribes",
+             pybind11::arg("callback"))
+        .def("clearCallbacks", &LidarManager::clearSubscriptions, "Drop every callback")
 
-        .def("workInLoop", &LidarManager::workInLoop, "Process Lidar data");
+        .def("workInLoop", &LidarManager::workInLoop, "Process Lidar data",
+             pybind11::call_guard<pybind11::gil_scoped_release>());
+
+    pybind11::class_<LidarFleet>(m, "LidarFleet")
+        .def(pybind11::init<>())
+        .def("addDeviceUDP", &LidarFleet::addDeviceUDP, "Initialize one more Lidar with UDP, returns its device index",
+             pybind11::arg("name"), pybind11::arg("lidar_ip"), pybind11::arg("lidar_port"),
+             pybind11::arg("local_ip"), pybind11::arg("local_port"),
+             pybind11::arg("length") = std::numeric_limits<double>::infinity(),
+             pybind11::arg("below_lidar_threshold") = -std::numeric_limits<double>::infinity(),
+             pybind11::arg("deskew") = false, pybind11::arg("batch") = 0,
+             pybind11::call_guard<pybind11::gil_scoped_release>())
+        .def("getName", &LidarFleet::getName, "Name of a device", pybind11::arg("device"))
+        .def("setExtrinsic", [](LidarFleet &fleet, size_t device, py::array_t<double, py::array::c_style | py::array::forcecast> matrix) {
+                 if (matrix.ndim() != 2 || matrix.shape(0) != 4 || matrix.shape(1) != 4) {
+                     throw std::runtime_error("The extrinsic must be a 4x4 matrix.");
+                 }
+                 fleet.setExtrinsic(device, matrix.data());
+             }, "Set the row-major 4x4 sensor to site transform of a device, its frames then come out in the site frame",
+             pybind11::arg("device"), pybind11::arg("matrix"))
+        .def("startLidar", &LidarFleet::startLidar, "Start the rotation of a Lidar", pybind11::arg("device"),
+             pybind11::call_guard<pybind11::gil_scoped_release>())
+        .def("stopLidar", &LidarFleet::stopLidar, "Stop the rotation of a Lidar", pybind11::arg("device"),
+             pybind11::call_guard<pybind11::gil_scoped_release>())
+        .def("startStreaming", &LidarFleet::startStreaming, "Start parsing every Lidar on a pool of native threads",
+             pybind11::arg("capacity") = 64, pybind11::arg("threads") = 1,
+             pybind11::call_guard<pybind11::gil_scoped_release>())
+        .def("stopStreaming", &LidarFleet::stopStreaming, "Stop the native threads",
+             pybind11::call_guard<pybind11::gil_scoped_release>())
+        .def("isStreaming", &LidarFleet::isStreaming, "Whether the native threads are running")
+        .def("getDroppedFrames", &LidarFleet::getDroppedFrames, "Number of frames of a device dropped while its ring was full",
+             pybind11::arg("device"))
+        .def("getFrameBatch", [](LidarFleet &fleet, int batchNum, double timeout) {
+                 std::vector<LidarFleet::TaggedFrame> batch;
+                 {
+                     py::gil_scoped_release release;
+                     batch = fleet.getFrameBatch(batchNum, timeout);
+                 }
+                 return batch;
+             }, "Wait for batchNum frames of any device, returns a list of (device, PointCloudSoA), "
+                "shorter once no device delivered a frame for timeout seconds",
+             pybind11::arg("batchNum") = 1, pybind11::arg("timeout") = 1.0)
+        .def("accumulatePointCloudBatch", pybind11::overload_cast<VoxelAccumulator &, int, double>(&LidarFleet::accumulatePointCloudBatch),
+             "Voxelize batchNum frames of every device into one grid, a device silent for timeout seconds is "
+             "given up, returns the number of points accumulated",
+             pybind11::arg("voxels"), pybind11::arg("batchNum"), pybind11::arg("timeout") = 1.0,
+             pybind11::call_guard<pybind11::gil_scoped_release>())
+        .def("accumulatePointCloudBatch", pybind11::overload_cast<size_t, VoxelAccumulator &, int, double>(&LidarFleet::accumulatePointCloudBatch),
+             "Voxelize batchNum frames of one device, stopping once it is silent for timeout seconds, returns "
+             "the number of points accumulated",
+             pybind11::arg("device"), pybind11::arg("voxels"), pybind11::arg("batchNum"), pybind11::arg("timeout") = 1.0,
+             pybind11::call_guard<pybind11::gil_scoped_release>())
+        .def("__len__", &LidarFleet::size);
 }
\ No newline at end of file
@@ -0,0 +1,283 @@
+#include <pybind11/pybind11.h>
+#include <pybind11/numpy.h>
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+#include "point_cloud_ops.h"
+
+namespace py = pybind11;
+
+typedef py::array_t<double, py::array::c_style | py::array::forcecast> PointArray;
+
+// Validate an (N, 3) point array, returns N
+static size_t pointCount(const PointArray& points) {
+    if (points.ndim() != 2 || points.shape(1) != 3) {
+        throw std::runtime_error("Points must be a 2-dimensional array of shape (N, 3).");
+    }
+    return points.shape(0);
+}
+
+static void checkRadius(double radius) {
+    if (!(radius > 0)) {
+        throw std::invalid_argument("radius must be positive.");
+    }
+}
+
+// Python interface of NeighbourIndex
+
+static py::array_t<bool> indexRadiusOutlierMask(const NeighbourIndex& index, int nb_points, double radius) {
+    checkRadius(radius);
+    py::array_t<bool> mask(static_cast<py::ssize_t>(index.size()));
+    bool* out = mask.mutable_data();
+    {
+        py::gil_scoped_release release;
+        index.radiusOutlierMaskInto(nb_points, radius, out);
+    }
+    return mask;
+}
+
+static py::array_t<bool> indexStatisticalOutlierMask(const NeighbourIndex& index, int nb_neighbors, double std_ratio) {
+    if (nb_neighbors < 1 || !(std_ratio > 0)) {
+        throw std::invalid_argument("nb_neighbors and std_ratio must be positive.");
+    }
+    py::array_t<bool> mask(static_cast<py::ssize_t>(index.size()));
+    bool* out = mask.mutable_data();
+    {
+        py::gil_scoped_release release;
+        index.statisticalOutlierMaskInto(nb_neighbors, std_ratio, out);
+    }
+    return mask;
+}
+
+static py::array_t<double> indexEstimateNormals(const NeighbourIndex& index, double radius, int max_nn) {
+    checkRadius(radius);
+    py::array_t<double> normals({static_cast<py::ssize_t>(index.size()), static_cast<py::ssize_t>(3)});
+    double* out = normals.mutable_data();
+    {
+        py::gil_scoped_release release;
+        index.estimateNormalsInto(radius, max_nn, out);
+    }
+    return normals;
+}
+
+static py::array_t<bool> indexHorizontalPlaneMask(const NeighbourIndex& index, double radius, int max_nn,
+                                                  double degrees_threshold) {
+    checkRadius(radius);
+    py::array_t<bool> mask(static_cast<py::ssize_t>(index.size()));
+    bool* out = mask.mutable_data();
+    {
+        py::gil_scoped_release release;
+        index.horizontalPlaneMaskInto(radius, max_nn, degrees_threshold, out);
+    }
+    return mask;
+}
+
+static void indexSelect(NeighbourIndex& index, py::array_t<bool, py::array::c_style | py::array::forcecast> mask) {
+    if (mask.ndim() != 1 || (size_t)mask.shape(0) != index.size()) {
+        throw std::runtime_error("Mask must be a 1-dimensional array with one entry per point.");
+    }
+    index.selectInto(mask.data());
+}
+
+static py::array_t<bool> indexActiveMask(const NeighbourIndex& index) {
+    py::array_t<bool> mask(static_cast<py::ssize_t>(index.size()));
+    bool* out = mask.mutable_data();
+    for (size_t i = 0; i < index.size(); i++) {
+        out[i] = index.isActive(i);
+    }
+    return mask;
+}
+
+static py::array_t<int64_t> indexActiveIndices(const NeighbourIndex& index) {
+    py::array_t<int64_t> indices(static_cast<py::ssize_t>(index.activeCount()));
+    int64_t* out = indices.mutable_data();
+    for (size_t i = 0; i < index.size(); i++) {
+        if (index.isActive(i)) {
+            *out++ = (int64_t)i;
+        }
+    }
+    return indices;
+}
+
+static py::array_t<double> indexActivePoints(const NeighbourIndex& index) {
+    py::array_t<double> points({static_cast<py::ssize_t>(index.activeCount()), static_cast<py::ssize_t>(3)});
+    double* out = points.mutable_data();
+    for (size_t i = 0; i < index.size(); i++) {
+        if (index.isActive(i)) {
+            std::copy(index.point(i), index.point(i) + 3, out);
+            out += 3;
+        }
+    }
+    return points;
+}
+
+/**
+ * @brief Build a NeighbourIndex over (N, 3) points
+ */
+std::unique_ptr<NeighbourIndex> makeNeighbourIndex(PointArray points, double cell_size, int num_threads) {
+    const size_t n = pointCount(points);
+    if (!(cell_size > 0)) {
+        throw std::invalid_argument("cell_size must be positive.");
+    }
+
+    const double* in = points.data();
+    py::gil_scoped_release release;
+    return std::unique_ptr<NeighbourIndex>(new NeighbourIndex(in, n, cell_size, num_threads));
+}
+
+/**
+ * @brief Estimate the normals of (N, 3) points, returns an (N, 3) float64 array
+ */
+py::array_t<double> estimateNormals(PointArray points, double radius, int max_nn, int num_threads) {
+    const size_t n = pointCount(points);
+    if (!(radius > 0)) {
+        throw std::invalid_argument("radius must be positive.");
+    }
+
+    py::array_t<double> normals({static_cast<py::ssize_t>(n), static_cast<py::ssize_t>(3)});
+    const double* in = points.data();
+    double* out = normals.mutable_data();
+    {
+        py::gil_scoped_release release;
+        NeighbourIndex(in, n, radius, num_threads).estimateNormalsInto(radius, max_nn, out);
+    }
+    return normals;
+}
+
+/**
+ * @brief Mask of the points whose normal is within degrees_threshold of the Z axis
+ */
+py::array_t<bool> horizontalPlaneMask(PointArray points, double radius, int max_nn, double degrees_threshold,
+                                      int num_threads) {
+    const size_t n = pointCount(points);
+    if (!(radius > 0)) {
+        throw std::invalid_argument("radius must be positive.");
+    }
+
+    py::array_t<bool> mask(static_cast<py::ssize_t>(n));
+    const double* in = points.data();
+    bool* out = mask.mutable_data();
+    {
+        py::gil_scoped_release release;
+        NeighbourIndex(in, n, radius, num_threads).horizontalPlaneMaskInto(radius, max_nn, degrees_threshold, out);
+    }
+    return mask;
+}
+
+/**
+ * @brief Mask of the points kept by the radius outlier test
+ */
+py::array_t<bool> radiusOutlierMask(PointArray points, int nb_points, double radius, int num_threads) {
+    const size_t n = pointCount(points);
+    if (!(radius > 0)) {
+        throw std::invalid_argument("radius must be positive.");
+    }
+
+    py::array_t<bool> mask(static_cast<py::ssize_t>(n));
+    const double* in = points.data();
+    bool* out = mask.mutable_data();
+    {
+        py::gil_scoped_release release;
+        NeighbourIndex(in, n, radius, num_threads).radiusOutlierMaskInto(nb_points, radius, out);
+    }
+    return mask;
+}
+
+/**
+ * @brief Fit a plane to the finite (N, 3) points, returns (model, inlier count, tilt in degrees)
+ * @note Throws (ValueError) if fewer than 3 points are finite or every sample drawn is collinear.
+ */
+py::tuple fitPlane(PointArray points, double distance_threshold, int num_iterations, double probability,
+                   int64_t seed) {
+    const size_t n = pointCount(points);
+    if (!(distance_threshold > 0)) {
+        throw std::invalid_argument("distance_threshold must be positive.");
+    }
+    if (num_iterations < 1) {
+        throw std::invalid_argument("num_iterations must be positive.");
+    }
+    if (!(probability > 0 && probability <= 1)) {
+        throw std::invalid_argument("probability must be in (0, 1].");
+    }
+
+    const double* in = points.data();
+    PlaneFit fit;
+    {
+        py::gil_scoped_release release;
+
+        // contiguous float columns for the vectorized inlier counting
+        std::vector<float> x, y, z;
+        x.reserve(n);
+        y.reserve(n);
+        z.reserve(n);
+        for (size_t i = 0; i < n; i++) {
+            const double* p = in + i * 3;
+            if (std::isfinite(p[0]) && std::isfinite(p[1]) && std::isfinite(p[2])) {
+                x.push_back((float)p[0]);
+                y.push_back((float)p[1]);
+                z.push_back((float)p[2]);
+            }
+        }
+        if (x.size() < 3) {
+            throw std::invalid_argument("At least 3 finite points are needed to fit a plane.");
+        }
+
+        const uint32_t state = seed < 0 ? std::random_device()() : (uint32_t)seed;
+        fit = fitPlaneInto(x.data(), y.data(), z.data(), x.size(), (float)distance_threshold, num_iterations,
+                           probability, state);
+        if (fit.degenerate) {
+            throw std::invalid_argument("The points are collinear, no plane can be fitted.");
+        }
+    }
+
+    py::array_t<double> model(4);
+    std::copy(fit.model, fit.model + 4, model.mutable_data());
+    return py::make_tuple(model, fit.inliers, fit.tilt_degrees);
+}
+
+PYBIND11_MODULE(pcdops, m) {
+    m.doc() = "Native point cloud operations over a hashed grid";
+
+    py::class_<NeighbourIndex>(m, "NeighbourIndex")
+        .def(py::init(&makeNeighbourIndex),
+             py::arg("points"), py::arg("cell_size") = 0.1, py::arg("num_threads") = 0)
+        .def("radius_outlier_mask", &indexRadiusOutlierMask,
+             "Mask of the active points with more than nb_points active points (self included) within radius",
+             py::arg("nb_points") = 2, py::arg("radius") = 0.1)
+        .def("statistical_outlier_mask", &indexStatisticalOutlierMask,
+             "Mask of the active points kept by open3d's remove_statistical_outlier test over the active points",
+             py::arg("nb_neighbors") = 20, py::arg("std_ratio") = 2.0)
+        .def("estimate_normals", &indexEstimateNormals,
+             "Unoriented normals from the active neighbours within radius (at most max_nn nearest), NaN for inactive points",
+             py::arg("radius") = 0.1, py::arg("max_nn") = 66)
+        .def("horizontal_plane_mask", &indexHorizontalPlaneMask,
+             "Mask of the active points whose normal is within degrees_threshold of the Z axis",
+             py::arg("radius") = 0.1, py::arg("max_nn") = 66, py::arg("degrees_threshold") = 5.0)
+        .def("select", &indexSelect,
+             "Deactivate the points whose mask entry is false",
+             py::arg("mask"))
+        .def("get_active_mask", &indexActiveMask)
+        .def("get_active_indices", &indexActiveIndices)
+        .def("get_active_points", &indexActivePoints)
+        .def("__len__", &NeighbourIndex::activeCount);
+
+    m.def("estimate_normals", &estimateNormals,
+          "Unoriented normals from the neighbours within radius (at most max_nn nearest), (N, 3) float64",
+          py::arg("points"), py::arg("radius") = 0.1, py::arg("max_nn") = 66, py::arg("num_threads") = 0);
+    m.def("horizontal_plane_mask", &horizontalPlaneMask,
+          "Mask of the points whose normal is within degrees_threshold of the Z axis",
+          py::arg("points"), py::arg("radius") = 0.1, py::arg("max_nn") = 66, py::arg("degrees_threshold") = 5.0,
+          py::arg("num_threads") = 0);
+    m.def("radius_outlier_mask", &radiusOutlierMask,
+          "Mask of the points with more than nb_points points (self included) within radius, like open3d's remove_radius_outlier",
+          py::arg("points"), py::arg("nb_points") = 2, py::arg("radius") = 0.1, py::arg("num_threads") = 0);
+    m.def("fit_plane", &fitPlane,
+          "MSAC plane fit refined by least squares, returns (a b c d with c >= 0, inlier count, tilt in degrees), "
+          "raises ValueError if the points are collinear",
+          py::arg("points"), py::arg("distance_threshold") = 0.01, py::arg("num_iterations") = 1000,
+          py::arg("probability") = 0.99999999, py::arg("seed") = -1);
+}
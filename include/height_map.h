@@ -0,0 +1,413 @@
+#pragma once
+
+#include <stdint.h>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+
+// Sum in numpy's pairwise order (np.add.reduce on a contiguous float64 array),
+// so that the mean matches np.mean() to the last bit
+inline double pairwiseSum(const double *a, size_t n)
+{
+    if (n < 8)
+    {
+        double res = 0.;
+        for (size_t i = 0; i < n; i++)
+        {
+            res += a[i];
+        }
+        return res;
+    }
+    else if (n <= 128)
+    {
+        double r[8];
+        for (size_t j = 0; j < 8; j++)
+        {
+            r[j] = a[j];
+        }
+        size_t i;
+        for (i = 8; i < n - (n % 8); i += 8)
+        {
+            for (size_t j = 0; j < 8; j++)
+            {
+                r[j] += a[i + j];
+            }
+        }
+        double res = ((r[0] + r[1]) + (r[2] + r[3])) + ((r[4] + r[5]) + (r[6] + r[7]));
+        for (; i < n; i++)
+        {
+            res += a[i];
+        }
+        return res;
+    }
+    else
+    {
+        size_t n2 = n / 2;
+        n2 -= n2 % 8;
+        return pairwiseSum(a, n2) + pairwiseSum(a + n2, n - n2);
+    }
+}
+
+struct Collection
+{
+    const double *points;
+    size_t rows;
+    size_t stride;
+};
+
+struct GridMetrics
+{
+    double volume = 0.0;
+    double area = 0.0;
+    double max_height = 0.0;
+    double mean_height = 0.0;
+    int quadrant = 0;
+};
+
+// Quadrant of (x, y), 0 if a coordinate is NaN
+inline int quadrantOf(double x, double y)
+{
+    if (x >= 0 && y >= 0)
+    {
+        return 1;
+    }
+    else if (x < 0 && y >= 0)
+    {
+        return 2;
+    }
+    else if (x < 0 && y < 0)
+    {
+        return 3;
+    }
+    else if (x >= 0 && y < 0)
+    {
+        return 4;
+    }
+    return 0;
+}
+
+inline GridMetrics computeMetrics(const std::vector<Collection> &collections, double floor_height, double grid_size,
+                                  double alert_height, double area_scale, double height_scale,
+                                  int min_valid_collections)
+{
+    // Calculate XY boundaries of the combined point cloud
+    double min_x = std::numeric_limits<double>::infinity(), max_x = -min_x;
+    double min_y = std::numeric_limits<double>::infinity(), max_y = -min_y;
+    size_t total_rows = 0;
+    for (const Collection &c : collections)
+    {
+        for (size_t i = 0; i < c.rows; i++)
+        {
+            const double *p = c.points + i * c.stride;
+            min_x = std::min(min_x, p[0]);
+            max_x = std::max(max_x, p[0]);
+            min_y = std::min(min_y, p[1]);
+            max_y = std::max(max_y, p[1]);
+        }
+        total_rows += c.rows;
+    }
+    if (total_rows == 0)
+    {
+        return GridMetrics();
+    }
+
+    // Determine grid dimensions based on spatial extent and grid size
+    const int64_t grid_x_count = (int64_t)std::ceil((max_x - min_x) / grid_size);
+    const int64_t grid_y_count = (int64_t)std::ceil((max_y - min_y) / grid_size);
+    const size_t cells = (size_t)grid_x_count * (size_t)grid_y_count;
+
+    std::vector<int> grid_valid_counts(cells, 0);
+    std::vector<double> grid_height_sums(cells, 0.0);
+
+    // Per-collection maximum height of each cell, `owner` tells which collection wrote it
+    std::vector<double> collection_heights(cells);
+    std::vector<int> owner(cells, -1);
+    std::vector<size_t> touched;
+
+    for (size_t c = 0; c < collections.size(); c++)
+    {
+        const Collection &collection = collections[c];
+        touched.clear();
+
+        for (size_t i = 0; i < collection.rows; i++)
+        {
+            const double *p = collection.points + i * collection.stride;
+
+            // Truncating cast like astype(int), points outside the grid are dropped
+            const double fx = (p[0] - min_x) / grid_size;
+            const double fy = (p[1] - min_y) / grid_size;
+            if (!(fx > -1.0 && fx < (double)grid_x_count && fy > -1.0 && fy < (double)grid_y_count))
+            {
+                continue;
+            }
+
+            // Only consider points above floor
+            const double height = floor_height - p[2];
+            if (!(height > 0))
+            {
+                continue;
+            }
+
+            const size_t cell = (size_t)(int64_t)fx * grid_y_count + (size_t)(int64_t)fy;
+            if (owner[cell] != (int)c)
+            {
+                owner[cell] = (int)c;
+                collection_heights[cell] = height;
+                touched.push_back(cell);
+            }
+            else if (height > collection_heights[cell])
+            {
+                collection_heights[cell] = height;
+            }
+        }
+
+        // Count the effective collection times and total height of each grid
+        for (size_t cell : touched)
+        {
+            grid_valid_counts[cell] += 1;
+            grid_height_sums[cell] += collection_heights[cell];
+        }
+    }
+
+    double total_volume = 0.0;
+    double total_area = 0.0;
+    std::vector<double> heights;
+    double max_height = -1;
+    double max_height_x = 0, max_height_y = 0;
+    const double cell_area = grid_size * grid_size;
+
+    // Process each grid cell to compute final metrics
+    for (int64_t gx = 0; gx < grid_x_count; gx++)
+    {
+        for (int64_t gy = 0; gy < grid_y_count; gy++)
+        {
+            const size_t cell = (size_t)gx * grid_y_count + gy;
+            const int n = grid_valid_counts[cell]; // Number of collections that detected this grid
+
+            // Cells no collection saw never count, even with min_valid_collections <= 0
+            if (n >= min_valid_collections && n > 0)
+            {
+                // Height = average of the highest points in n collections
+                const double avg_height = (grid_height_sums[cell] / n) * height_scale;
+                const double volume = avg_height * (cell_area * area_scale);
+                const double area = cell_area * area_scale;
+
+                total_volume += volume;
+                total_area += area;
+                heights.push_back(avg_height);
+
+                if (avg_height > max_height)
+                {
+                    max_height = avg_height;
+                    max_height_x = min_x + (gx + 0.5) * grid_size;
+                    max_height_y = min_y + (gy + 0.5) * grid_size;
+                }
+            }
+        }
+    }
+
+    GridMetrics metrics;
+    metrics.volume = total_volume;
+    metrics.area = total_area;
+    metrics.max_height = max_height;
+    metrics.mean_height = heights.empty() ? 0.0 : pairwiseSum(heights.data(), heights.size()) / heights.size();
+
+    if (max_height > alert_height)
+    {
+        metrics.quadrant = quadrantOf(max_height_x, max_height_y);
+    }
+
+    return metrics;
+}
+
+/**
+ * Persistent 2.5D height map of the storage area [-length, length)^2, cells are anchored at
+ * (-length, -length) so they never move between collections. Every collection owns a slot of
+ * a ring holding the `collections` most recent ones, where the points update in place the
+ * lowest z (the highest point, z+ points downwards) and the hit count of their cell. The
+ * metrics of the window are computed on demand in O(cells) for the floor height of the moment,
+ * with the same votes as computeMetrics(), without keeping any point.
+ */
+class HeightMap
+{
+public:
+    HeightMap(double length, double grid_size, int collections)
+    {
+        if (!(length > 0) || !std::isfinite(length))
+        {
+            throw std::invalid_argument("length must be positive and finite.");
+        }
+        if (!(grid_size > 0.0))
+        {
+            throw std::invalid_argument("grid_size must be positive.");
+        }
+        if (collections < 1)
+        {
+            throw std::invalid_argument("collections must be positive.");
+        }
+
+        length_ = length;
+        grid_size_ = grid_size;
+        grid_x_count_ = (int64_t)std::ceil(2 * length / grid_size);
+        grid_y_count_ = grid_x_count_;
+        cells_ = (size_t)grid_x_count_ * (size_t)grid_y_count_;
+        slots_ = collections;
+        lowest_z_.assign(slots_ * cells_, std::numeric_limits<double>::infinity());
+        hits_.assign(slots_ * cells_, 0);
+    }
+
+    // Start a new collection in place of the oldest one
+    void beginCollection()
+    {
+        current_ = (current_ + 1) % slots_;
+        filled_ = std::min(filled_ + 1, slots_);
+        std::fill(lowest_z_.begin() + current_ * cells_, lowest_z_.begin() + (current_ + 1) * cells_,
+                  std::numeric_limits<double>::infinity());
+        std::fill(hits_.begin() + current_ * cells_, hits_.begin() + (current_ + 1) * cells_, 0);
+    }
+
+    // Add rows points of `stride` doubles (x, y, z first) to the current collection,
+    // returns the number of points inside the map
+    size_t insert(const double *data, size_t rows, size_t stride)
+    {
+        if (rows == 0)
+        {
+            return 0;
+        }
+        if (filled_ == 0)
+        {
+            beginCollection();
+        }
+
+        size_t inserted = 0;
+        double *lowest_z = lowest_z_.data() + current_ * cells_;
+        uint32_t *hits = hits_.data() + current_ * cells_;
+        for (size_t i = 0; i < rows; i++)
+        {
+            const double *p = data + i * stride;
+            const double fx = (p[0] + length_) / grid_size_;
+            const double fy = (p[1] + length_) / grid_size_;
+            if (!(fx >= 0.0 && fx < (double)grid_x_count_ && fy >= 0.0 && fy < (double)grid_y_count_) ||
+                std::isnan(p[2]))
+            {
+                continue;
+            }
+
+            const size_t cell = (size_t)(int64_t)fx * grid_y_count_ + (size_t)(int64_t)fy;
+            lowest_z[cell] = std::min(lowest_z[cell], p[2]);
+            hits[cell]++;
+            inserted++;
+        }
+        return inserted;
+    }
+
+    // Forget every collection
+    void clear()
+    {
+        std::fill(lowest_z_.begin(), lowest_z_.end(), std::numeric_limits<double>::infinity());
+        std::fill(hits_.begin(), hits_.end(), 0);
+        filled_ = 0;
+        current_ = 0;
+    }
+
+    /**
+     * Metrics of the collections in the window, like computeMetrics() on their points.
+     * All zeros while the window is empty.
+     */
+    GridMetrics computeMetrics(double floor_height, double alert_height, double area_scale, double height_scale,
+                               int min_valid_collections) const
+    {
+        GridMetrics metrics;
+        if (filled_ == 0)
+        {
+            return metrics;
+        }
+
+        double total_volume = 0.0;
+        double total_area = 0.0;
+        std::vector<double> heights;
+        double max_height = -1;
+        double max_height_x = 0, max_height_y = 0;
+        const double cell_area = grid_size_ * grid_size_;
+
+        for (int64_t gx = 0; gx < grid_x_count_; gx++)
+        {
+            for (int64_t gy = 0; gy < grid_y_count_; gy++)
+            {
+                const size_t cell = (size_t)gx * grid_y_count_ + gy;
+
+                // Collections vote the maximum height above the floor, oldest first
+                int n = 0;
+                double height_sum = 0.0;
+                for (size_t k = 0; k < filled_; k++)
+                {
+                    const size_t slot = (current_ + slots_ - (filled_ - 1) + k) % slots_;
+                    const double height = floor_height - lowest_z_[slot * cells_ + cell];
+                    if (height > 0)
+                    {
+                        n++;
+                        height_sum += height;
+                    }
+                }
+
+                if (n >= min_valid_collections && n > 0)
+                {
+                    const double avg_height = (height_sum / n) * height_scale;
+                    const double area = cell_area * area_scale;
+
+                    total_volume += avg_height * area;
+                    total_area += area;
+                    heights.push_back(avg_height);
+
+                    if (avg_height > max_height)
+                    {
+                        max_height = avg_height;
+                        max_height_x = -length_ + (gx + 0.5) * grid_size_;
+                        max_height_y = -length_ + (gy + 0.5) * grid_size_;
+                    }
+                }
+            }
+        }
+
+        metrics.volume = total_volume;
+        metrics.area = total_area;
+        metrics.max_height = max_height;
+        metrics.mean_height = heights.empty() ? 0.0 : pairwiseSum(heights.data(), heights.size()) / heights.size();
+        if (max_height > alert_height)
+        {
+            metrics.quadrant = quadrantOf(max_height_x, max_height_y);
+        }
+        return metrics;
+    }
+
+    // Points of every cell summed over the window into out, gridXCount() x gridYCount() row-major
+    void hitCounts(uint32_t *out) const
+    {
+        std::fill(out, out + cells_, 0);
+        for (size_t slot = 0; slot < slots_; slot++)
+        {
+            for (size_t cell = 0; cell < cells_; cell++)
+            {
+                out[cell] += hits_[slot * cells_ + cell];
+            }
+        }
+    }
+
+    int64_t gridXCount() const { return grid_x_count_; }
+    int64_t gridYCount() const { return grid_y_count_; }
+    size_t collectionNumber() const { return filled_; }
+
+private:
+    double length_;
+    double grid_size_;
+    int64_t grid_x_count_;
+    int64_t grid_y_count_;
+    size_t cells_;
+    size_t slots_;
+    size_t filled_ = 0;           // collections in the window
+    size_t current_ = 0;          // slot of the newest collection
+    std::vector<double> lowest_z_; // slot-major lowest z of every cell, +inf when not hit
+    std::vector<uint32_t> hits_;   // slot-major number of points of every cell
+};
@@ -0,0 +1,511 @@
+#pragma once
+
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+#include <cmath>
+#include <string>
+#include <vector>
+#include "unitree_lidar_sdk.h"
+
+namespace unilidar_sdk2{
+
+/**
+ * @brief Capture file format
+ * @note A capture is the 8 bytes of CAPTURE_MAGIC followed by records, each one a
+ *       CaptureRecordHeader and then the raw packet (FrameHeader to FrameTail) as
+ *       parsed by the reader. Numbers are stored in the byte order of the host.
+ */
+const char CAPTURE_MAGIC[8] = {'U', 'L', 'C', 'A', 'P', '0', '0', '1'};
+
+typedef struct
+{
+    uint64_t recv_ns;     // CLOCK_REALTIME when the packet was received [ns]
+    uint32_t packet_type; // LIDAR_*_PACKET_TYPE
+    uint32_t size;        // bytes of the packet that follows
+} CaptureRecordHeader;
+
+/**
+ * @brief Appends the packets parsed by a reader to a capture file
+ * @note Writes go through the stdio buffer, call close() (or destroy the writer) to
+ *       flush them. A write that fails closes the capture, the failure is then reported
+ *       by failed() and close(). One instance must only be used by one thread at a time.
+ */
+class LidarCaptureWriter
+{
+public:
+    ~LidarCaptureWriter() { close(); }
+
+    /**
+     * @brief Create (or truncate) the capture at path
+     * @return false if the file can not be written
+     */
+    bool open(const std::string &path)
+    {
+        close();
+        failed_ = false;
+        file_ = fopen(path.c_str(), "wb");
+        if (file_ == nullptr)
+        {
+            return false;
+        }
+        records_ = 0;
+        if (fwrite(CAPTURE_MAGIC, sizeof(CAPTURE_MAGIC), 1, file_) != 1)
+        {
+            fail();
+            return false;
+        }
+        return true;
+    }
+
+    bool isOpen() const { return file_ != nullptr; }
+
+    /**
+     * @brief Number of records written, those before a failure are in the capture
+     */
+    size_t records() const { return records_; }
+
+    /**
+     * @brief Whether a write failed since open(), the capture is then closed and incomplete
+     */
+    bool failed() const { return failed_; }
+
+    /**
+     * @brief Record the packet just parsed by reader, if it carries a payload worth replaying
+     * @param result value returned by reader.runParse()
+     * @param stamp receive time of the packet [s], CLOCK_REALTIME like getSystemTimeStamp()
+     * @return false if the packet could not be written, the capture is then closed
+     */
+    bool record(const UnitreeLidarReader &reader, int result, double stamp)
+    {
+        switch (result)
+        {
+        case LIDAR_POINT_DATA_PACKET_TYPE:
+            return write(result, &reader.getLidarPointDataPacket(), sizeof(LidarPointDataPacket), stamp);
+        case LIDAR_2D_POINT_DATA_PACKET_TYPE:
+            return write(result, &reader.getLidar2DPointDataPacket(), sizeof(Lidar2DPointDataPacket), stamp);
+        case LIDAR_IMU_DATA_PACKET_TYPE:
+            return write(result, &reader.getLidarImuDataPacket(), sizeof(LidarImuDataPacket), stamp);
+        case LIDAR_VERSION_PACKET_TYPE:
+            return write(result, &reader.getLidarVersionDataPacket(), sizeof(LidarVersionDataPacket), stamp);
+        default:
+            return true;
+        }
+    }
+
+    /**
+     * @return false if the record could not be written, the capture is then closed
+     */
+    bool write(int packet_type, const void *packet, uint32_t size, double stamp)
+    {
+        if (file_ == nullptr)
+        {
+            return false;
+        }
+
+        const CaptureRecordHeader header = {(uint64_t)std::llround(stamp * 1e9), (uint32_t)packet_type, size};
+        if (fwrite(&header, sizeof(header), 1, file_) != 1 || fwrite(packet, size, 1, file_) != 1)
+        {
+            fail();
+            return false;
+        }
+        records_++;
+        return true;
+    }
+
+    /**
+     * @brief Flush and close the capture
+     * @return false if a write failed since open() or the buffered records could not be flushed
+     */
+    bool close()
+    {
+        if (file_ != nullptr && fclose(file_) != 0)
+        {
+            failed_ = true;
+        }
+        file_ = nullptr;
+        return !failed_;
+    }
+
+private:
+    void fail()
+    {
+        fclose(file_);
+        file_ = nullptr;
+        failed_ = true;
+    }
+
+    FILE *file_ = nullptr;
+    size_t records_ = 0;
+    bool failed_ = false;
+};
+
+/**
+ * @brief Reader which plays a capture back through the UnitreeLidarReader interface
+ * @note Records are released at their recorded pace divided by speed, speed <= 0
+ *       releases them as fast as they are parsed. runParse() returns 0 while the next
+ *       record is not due and once the capture is over (unless it loops), like a live
+ *       reader with nothing buffered. Packets keep their recorded receive times, shifted
+ *       so that the replay starts at the system time it is started (again at every loop),
+ *       so the rest of the pipeline sees the spacing of the live sensor whatever the
+ *       speed. Point clouds are assembled from cloud_scan_num packets. A record that can
+ *       not come from LidarCaptureWriter ends the capture. Commands sent to the lidar are
+ *       ignored.
+ */
+class ReplayLidarReader : public UnitreeLidarReader
+{
+public:
+    ~ReplayLidarReader() { closeReplay(); }
+
+    /**
+     * @brief Open a capture
+     * @return 0 on success, -1 if the file can not be read or is not a capture
+     */
+    int initializeReplay(const std::string &path, double speed = 1.0, bool loop = false,
+                         uint16_t cloud_scan_num = 18, float range_min = 0, float range_max = 100)
+    {
+        closeReplay();
+        file_ = fopen(path.c_str(), "rb");
+        if (file_ == nullptr)
+        {
+            return -1;
+        }
+
+        char magic[sizeof(CAPTURE_MAGIC)];
+        if (fread(magic, sizeof(magic), 1, file_) != 1 || memcmp(magic, CAPTURE_MAGIC, sizeof(magic)) != 0)
+        {
+            closeReplay();
+            return -1;
+        }
+
+        speed_ = speed;
+        loop_ = loop;
+        cloud_scan_num_ = cloud_scan_num > 0 ? cloud_scan_num : 1;
+        range_min_ = range_min;
+        range_max_ = range_max;
+        has_next_ = false;
+        started_ = false;
+        scan_packets_.clear();
+        scan_stamps_.clear();
+        cloud_ready_ = false;
+        cloud_count_ = 0;
+        return 0;
+    }
+
+    bool closeReplay()
+    {
+        if (file_ == nullptr)
+        {
+            return false;
+        }
+        fclose(file_);
+        file_ = nullptr;
+        return true;
+    }
+
+    int initializeSerial(std::string, uint32_t, uint16_t, bool, float, float) override { return -1; }
+
+    int initializeUDP(unsigned short, std::string, unsigned short, std::string, uint16_t, bool, float,
+                      float) override
+    {
+        return -1;
+    }
+
+    bool closeSerial() override { return closeReplay(); }
+
+    bool closeUDP() override { return closeReplay(); }
+
+    int runParse() override
+    {
+        cloud_ready_ = false;
+        if (!has_next_ && !readNext())
+        {
+            return 0;
+        }
+
+        const auto now = std::chrono::steady_clock::now();
+        if (!started_)
+        {
+            started_ = true;
+            start_ = now;
+            start_stamp_ = getSystemTimeStamp();
+            first_recv_ns_ = next_.recv_ns;
+        }
+        const double elapsed_ns = (double)(int64_t)(next_.recv_ns - first_recv_ns_);
+        if (speed_ > 0 && std::chrono::duration<double, std::nano>(now - start_).count() < elapsed_ns / speed_)
+        {
+            return 0;
+        }
+        has_next_ = false;
+        last_stamp_ = start_stamp_ + elapsed_ns * 1e-9;
+
+        switch (next_.packet_type)
+        {
+        case LIDAR_POINT_DATA_PACKET_TYPE:
+            if (!copyPayload(point_packet_))
+            {
+                return 0;
+            }
+            scan_packets_.push_back(point_packet_);
+            scan_stamps_.push_back(last_stamp_ - point_packet_.data.scan_period);
+            if (scan_packets_.size() >= cloud_scan_num_)
+            {
+                assembleCloud();
+            }
+            break;
+        case LIDAR_2D_POINT_DATA_PACKET_TYPE:
+            if (!copyPayload(point_2d_packet_))
+            {
+                return 0;
+            }
+            break;
+        case LIDAR_IMU_DATA_PACKET_TYPE:
+            if (!copyPayload(imu_packet_))
+            {
+                return 0;
+            }
+            has_imu_ = true;
+            break;
+        case LIDAR_VERSION_PACKET_TYPE:
+            if (!copyPayload(version_packet_))
+            {
+                return 0;
+            }
+            has_version_ = true;
+            break;
+        default:
+            return 0;
+        }
+        return next_.packet_type;
+    }
+
+    void clearBuffer() override
+    {
+        scan_packets_.clear();
+        scan_stamps_.clear();
+    }
+
+    const LidarPointDataPacket &getLidarPointDataPacket() const override { return point_packet_; }
+
+    const Lidar2DPointDataPacket &getLidar2DPointDataPacket() const override { return point_2d_packet_; }
+
+    const LidarImuDataPacket &getLidarImuDataPacket() const override { return imu_packet_; }
+
+    const LidarVersionDataPacket &getLidarVersionDataPacket() const override { return version_packet_; }
+
+    /**
+     * @brief The point cloud completed by the last runParse(), if any
+     */
+    bool getPointCloud(PointCloudUnitree &cloud) const override
+    {
+        if (!cloud_ready_)
+        {
+            return false;
+        }
+        cloud = cloud_;
+        return true;
+    }
+
+    bool getImuData(LidarImuData &imu) const override
+    {
+        if (!has_imu_)
+        {
+            return false;
+        }
+        imu = imu_packet_.data;
+        return true;
+    }
+
+    bool getVersionOfSDK(std::string &version) const override
+    {
+        version = "replay";
+        return true;
+    }
+
+    bool getVersionOfLidarFirmware(std::string &version) const override
+    {
+        version = has_version_ ? formatVersion(version_packet_.data.sw_version) : "replay";
+        return true;
+    }
+
+    bool getVersionOfLidarHardware(std::string &version) const override
+    {
+        version = has_version_ ? formatVersion(version_packet_.data.hw_version) : "replay";
+        return true;
+    }
+
+    bool getTimeDelay(double &delay) const override
+    {
+        delay = 0;
+        return true;
+    }
+
+    bool getDirtyPercentage(float &percentage) const override
+    {
+        percentage = 0;
+        return true;
+    }
+
+    void sendUserCtrlCmd(LidarUserCtrlCmd) override {}
+
+    void setLidarWorkMode(uint32_t) override {}
+
+    void syncLidarTimeStamp() override {}
+
+    void resetLidar() override {}
+
+    void stopLidarRotation() override {}
+
+    void startLidarRotation() override {}
+
+    void setLidarIpAddressConfig(LidarIpAddressConfig) override {}
+
+    void setLidarMacAddressConfig(LidarMacAddressConfig) override {}
+
+    size_t getBufferCachedSize() const override { return has_next_ ? next_.size : 0; }
+
+    /**
+     * @brief Receive time of the packet returned by the last runParse() [s], its recorded
+     *        one shifted to the start of the replay, CLOCK_REALTIME like getSystemTimeStamp()
+     */
+    double lastPacketStamp() const { return last_stamp_; }
+
+    size_t getBufferReadSize() const override { return 0; }
+
+private:
+    /**
+     * @brief Read the next record into next_ and payload_, rewind first if looping
+     */
+    bool readNext()
+    {
+        if (file_ == nullptr)
+        {
+            return false;
+        }
+
+        for (int attempt = 0; attempt < 2; attempt++)
+        {
+            if (fread(&next_, sizeof(next_), 1, file_) == 1)
+            {
+                if (!validRecord(next_))
+                {
+                    // the capture is corrupt from here, it ends
+                    fseek(file_, 0, SEEK_END);
+                }
+                else
+                {
+                    payload_.resize(next_.size);
+                    if (next_.size == 0 || fread(payload_.data(), next_.size, 1, file_) == 1)
+                    {
+                        has_next_ = true;
+                        return true;
+                    }
+                }
+            }
+            if (!loop_)
+            {
+                return false;
+            }
+
+            // play the capture again from its first record, at the same pace
+            fseek(file_, sizeof(CAPTURE_MAGIC), SEEK_SET);
+            started_ = false;
+        }
+        return false;
+    }
+
+    /**
+     * @brief Whether a record header can come from LidarCaptureWriter::record(), checked
+     *        before its size is trusted
+     */
+    static bool validRecord(const CaptureRecordHeader &header)
+    {
+        switch (header.packet_type)
+        {
+        case LIDAR_POINT_DATA_PACKET_TYPE:
+        case LIDAR_2D_POINT_DATA_PACKET_TYPE:
+        case LIDAR_IMU_DATA_PACKET_TYPE:
+        case LIDAR_VERSION_PACKET_TYPE:
+            return header.size <= sizeof(Lidar2DPointDataPacket);
+        default:
+            return false;
+        }
+    }
+
+    template <typename Packet>
+    bool copyPayload(Packet &packet) const
+    {
+        if (payload_.size() != sizeof(Packet))
+        {
+            return false;
+        }
+        memcpy(&packet, payload_.data(), sizeof(Packet));
+        return true;
+    }
+
+    void assembleCloud()
+    {
+        cloud_.stamp = scan_stamps_[0];
+        cloud_.id = ++cloud_count_;
+        cloud_.ringNum = 1;
+        cloud_.points.clear();
+
+        PointCloudUnitree packet_cloud;
+        for (size_t k = 0; k < scan_packets_.size(); k++)
+        {
+            threadLocalProjector().project(packet_cloud, scan_packets_[k].data, range_min_, range_max_);
+            const float offset = (float)(scan_stamps_[k] - cloud_.stamp);
+            for (PointUnitree &point : packet_cloud.points)
+            {
+                point.time += offset;
+                cloud_.points.push_back(point);
+            }
+        }
+
+        scan_packets_.clear();
+        scan_stamps_.clear();
+        cloud_ready_ = true;
+    }
+
+    static std::string formatVersion(const uint8_t version[4])
+    {
+        return std::to_string(version[0]) + "." + std::to_string(version[1]) + "." +
+               std::to_string(version[2]) + "." + std::to_string(version[3]);
+    }
+
+    FILE *file_ = nullptr;
+    double speed_ = 1.0;
+    bool loop_ = false;
+    size_t cloud_scan_num_ = 18;
+    float range_min_ = 0;
+    float range_max_ = 100;
+
+    // next record of the capture, read ahead until it is due
+    CaptureRecordHeader next_;
+    std::vector<uint8_t> payload_;
+    bool has_next_ = false;
+
+    // pace of the replay
+    bool started_ = false;
+    std::chrono::steady_clock::time_point start_;
+    double start_stamp_ = 0; // system time of the start, the first record is stamped with
+    uint64_t first_recv_ns_ = 0;
+
+    // last packets released
+    double last_stamp_ = 0;
+    LidarPointDataPacket point_packet_;
+    Lidar2DPointDataPacket point_2d_packet_;
+    LidarImuDataPacket imu_packet_;
+    LidarVersionDataPacket version_packet_;
+    bool has_imu_ = false;
+    bool has_version_ = false;
+
+    // packets of the point cloud under construction
+    std::vector<LidarPointDataPacket> scan_packets_;
+    std::vector<double> scan_stamps_;
+    PointCloudUnitree cloud_;
+    bool cloud_ready_ = false;
+    uint32_t cloud_count_ = 0; // point clouds assembled since the replay was initialized, numbers them
+};
+
+} // end of namespace unilidar_sdk2
@@ -0,0 +1,792 @@
+#pragma once
+
+#include <stdint.h>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <limits>
+#include <memory>
+#include <random>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "spatial_grid.h"
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#define POINT_CLOUD_OPS_SSE2 1
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#define POINT_CLOUD_OPS_NEON 1
+#endif
+
+// Run body(begin, end) over chunks of [0, n) on num_threads threads (<= 0: every hardware thread)
+template <typename Body>
+inline void parallelFor(size_t n, int num_threads, Body body)
+{
+    if (num_threads <= 0)
+    {
+        num_threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    const size_t chunk = 256;
+    if (num_threads == 1 || n <= chunk)
+    {
+        body(0, n);
+        return;
+    }
+
+    std::atomic<size_t> next(0);
+    auto worker = [&]() {
+        for (size_t begin = next.fetch_add(chunk); begin < n; begin = next.fetch_add(chunk))
+        {
+            body(begin, std::min(n, begin + chunk));
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (int t = 1; t < num_threads; t++)
+    {
+        workers.emplace_back(worker);
+    }
+    worker();
+    for (auto &w : workers)
+    {
+        w.join();
+    }
+}
+
+inline double norm2(const double v[3])
+{
+    return v[0] * v[0] + v[1] * v[1] + v[2] * v[2];
+}
+
+inline void cross(const double a[3], const double b[3], double out[3])
+{
+    out[0] = a[1] * b[2] - a[2] * b[1];
+    out[1] = a[2] * b[0] - a[0] * b[2];
+    out[2] = a[0] * b[1] - a[1] * b[0];
+}
+
+// Unit eigenvector of `eigenvalue` of the symmetric matrix a (a00 a01 a02 a11 a12 a22),
+// the most stable cross product of two rows of (a - eigenvalue * I); false if the
+// eigenvalue is not simple
+inline bool eigenvector(const double a[6], double eigenvalue, double out[3])
+{
+    const double r0[3] = {a[0] - eigenvalue, a[1], a[2]};
+    const double r1[3] = {a[1], a[3] - eigenvalue, a[4]};
+    const double r2[3] = {a[2], a[4], a[5] - eigenvalue};
+
+    double c[3][3];
+    cross(r0, r1, c[0]);
+    cross(r0, r2, c[1]);
+    cross(r1, r2, c[2]);
+
+    int best = 0;
+    double best_norm = norm2(c[0]);
+    for (int k = 1; k < 3; k++)
+    {
+        const double n = norm2(c[k]);
+        if (n > best_norm)
+        {
+            best = k;
+            best_norm = n;
+        }
+    }
+    if (!(best_norm > 1e-24))
+    {
+        return false;
+    }
+
+    const double inv = 1.0 / std::sqrt(best_norm);
+    out[0] = c[best][0] * inv;
+    out[1] = c[best][1] * inv;
+    out[2] = c[best][2] * inv;
+    return true;
+}
+
+// Eigenvector of the smallest eigenvalue of a symmetric 3x3 covariance (c00 c01 c02 c11 c12 c22),
+// closed-form eigenvalues (trigonometric solution of the characteristic cubic)
+inline void smallestEigenvector(const double cov[6], double normal[3])
+{
+    double max_coeff = 0;
+    for (int k = 0; k < 6; k++)
+    {
+        max_coeff = std::max(max_coeff, std::fabs(cov[k]));
+    }
+    if (max_coeff == 0)
+    {
+        // all neighbours coincide
+        normal[0] = normal[1] = normal[2] = 0;
+        return;
+    }
+
+    // scale to avoid over/underflow
+    double a[6];
+    for (int k = 0; k < 6; k++)
+    {
+        a[k] = cov[k] / max_coeff;
+    }
+
+    const double off = a[1] * a[1] + a[2] * a[2] + a[4] * a[4];
+    if (off == 0)
+    {
+        // already diagonal
+        const int axis = (a[0] <= a[3] && a[0] <= a[5]) ? 0 : (a[3] <= a[5] ? 1 : 2);
+        normal[0] = axis == 0;
+        normal[1] = axis == 1;
+        normal[2] = axis == 2;
+        return;
+    }
+
+    const double q = (a[0] + a[3] + a[5]) / 3.0;
+    const double b00 = a[0] - q;
+    const double b11 = a[3] - q;
+    const double b22 = a[5] - q;
+    const double p = std::sqrt((b00 * b00 + b11 * b11 + b22 * b22 + 2.0 * off) / 6.0);
+
+    const double c00 = b11 * b22 - a[4] * a[4];
+    const double c01 = a[1] * b22 - a[4] * a[2];
+    const double c02 = a[1] * a[4] - b11 * a[2];
+    const double det = (b00 * c00 - a[1] * c01 + a[2] * c02) / (p * p * p);
+    const double half_det = std::min(std::max(det * 0.5, -1.0), 1.0);
+
+    // eigenvalues q + 2p cos(angle + 2k pi / 3), the smallest for k = 1
+    const double angle = std::acos(half_det) / 3.0;
+    const double eval_min = q + p * 2.0 * std::cos(angle + 2.0 * M_PI / 3.0);
+    const double eval_max = q + p * 2.0 * std::cos(angle);
+
+    if (eigenvector(a, eval_min, normal))
+    {
+        return;
+    }
+
+    // the smallest eigenvalue is double (line-like neighbourhood), any direction
+    // orthogonal to the principal axis is a normal
+    double axis[3];
+    if (eigenvector(a, eval_max, axis))
+    {
+        const double helper[3] = {std::fabs(axis[0]) < 0.9 ? 1.0 : 0.0, std::fabs(axis[0]) < 0.9 ? 0.0 : 1.0, 0.0};
+        cross(axis, helper, normal);
+        const double inv = 1.0 / std::sqrt(norm2(normal));
+        normal[0] *= inv;
+        normal[1] *= inv;
+        normal[2] *= inv;
+        return;
+    }
+
+    // isotropic
+    normal[0] = 0;
+    normal[1] = 0;
+    normal[2] = 1;
+}
+
+/**
+ * @brief Hashed grid over a copy of (N, 3) points, shared by a chain of neighbourhood filters
+ * @note Every query only sees the active points, so narrowing the active set with select()
+ *       between two filters behaves like running the second filter on the cloud left by the
+ *       first one, without building a new index. Masks and normals are indexed like the
+ *       original points; inactive points are never kept and get NaN normals.
+ */
+class NeighbourIndex
+{
+public:
+    NeighbourIndex(const double *points, size_t n, double cell_size, int num_threads)
+        : points_(points, points + n * 3), cell_size_(cell_size), num_threads_(num_threads), active_(n, 1)
+    {
+        // cells slightly larger than cell_size, rounding can never push a neighbour one ring further
+        grid_.reset(new SpatialGrid<double>(points_.data(), n, 3, 3, cell_size * (1.0 + 1e-6)));
+        for (size_t i = 0; i < n; i++)
+        {
+            indexed_ += grid_->cellOf(i) != SpatialGrid<double>::NO_CELL;
+        }
+        active_count_ = n;
+        indexed_active_ = indexed_;
+    }
+
+    size_t size() const { return active_.size(); }
+    size_t activeCount() const { return active_count_; }
+    bool isActive(size_t i) const { return active_[i]; }
+    const double *point(size_t i) const { return points_.data() + i * 3; }
+
+    /**
+     * @brief Deactivate the points whose mask entry is false
+     */
+    void selectInto(const bool *mask)
+    {
+        for (size_t i = 0; i < active_.size(); i++)
+        {
+            if (active_[i] && !mask[i])
+            {
+                active_[i] = 0;
+                active_count_--;
+                indexed_active_ -= grid_->cellOf(i) != SpatialGrid<double>::NO_CELL;
+            }
+        }
+    }
+
+    /**
+     * @brief Radius outlier test like open3d's remove_radius_outlier: a point is kept if more
+     *        than nb_points active points (itself included) lie strictly within radius
+     * @note Work is split over grid cells, the neighbour cells are looked up once per cell
+     *       and the scan of a point stops as soon as it is known to be kept.
+     */
+    void radiusOutlierMaskInto(int nb_points, double radius, bool *keep) const
+    {
+        const SpatialGrid<double> &grid = *grid_;
+        const int rings = ringsFor(radius);
+        const double radius2 = radius * radius;
+        const size_t needed = nb_points < 0 ? 0 : (size_t)nb_points + 1;
+
+        // points with a non-finite coordinate have no neighbours
+        for (size_t i = 0; i < size(); i++)
+        {
+            keep[i] = active_[i] && grid.cellOf(i) == SpatialGrid<double>::NO_CELL && needed == 0;
+        }
+
+        // true once p has `needed` active points within radius in the given buckets
+        auto enoughNeighbours = [&](const double *p, const uint32_t *cells, size_t num_cells) {
+            size_t count = 0;
+            for (size_t k = 0; k < num_cells; k++)
+            {
+                for (const uint32_t *it = grid.cellBegin(cells[k]); it != grid.cellEnd(cells[k]); ++it)
+                {
+                    if (!active_[*it])
+                    {
+                        continue;
+                    }
+                    const double *q = point(*it);
+                    const double dx = q[0] - p[0], dy = q[1] - p[1], dz = q[2] - p[2];
+                    if (dx * dx + dy * dy + dz * dz < radius2 && ++count >= needed)
+                    {
+                        return true;
+                    }
+                }
+            }
+            return count >= needed;
+        };
+
+        parallelFor(grid.cellCount(), num_threads_, [&](size_t begin, size_t end) {
+            std::vector<uint32_t> cells, own_cells;
+            for (size_t c = begin; c < end; c++)
+            {
+                const double *first = grid.point(*grid.cellBegin(c));
+                cells.clear();
+                grid.forEachNeighbourCell(first, rings, [&](uint32_t nc) { cells.push_back(nc); });
+
+                for (const uint32_t *it = grid.cellBegin(c); it != grid.cellEnd(c); ++it)
+                {
+                    if (!active_[*it])
+                    {
+                        continue;
+                    }
+                    const double *p = grid.point(*it);
+                    if (grid.sameCell(p, first))
+                    {
+                        keep[*it] = enoughNeighbours(p, cells.data(), cells.size());
+                    }
+                    else
+                    {
+                        // the bucket holds a colliding cell, look its neighbours up separately
+                        own_cells.clear();
+                        grid.forEachNeighbourCell(p, rings, [&](uint32_t nc) { own_cells.push_back(nc); });
+                        keep[*it] = enoughNeighbours(p, own_cells.data(), own_cells.size());
+                    }
+                }
+            }
+        });
+    }
+
+    /**
+     * @brief Statistical outlier test like open3d's remove_statistical_outlier
+     * @note The mean distance of every active point to its nb_neighbors nearest active points
+     *       (itself included) is compared against the cloud mean + std_ratio * std of those
+     *       means. The statistics reproduce open3d's, down to points whose mean distance is 0
+     *       being left out of the sums but not of the count, and such points being removed.
+     */
+    void statisticalOutlierMaskInto(int nb_neighbors, double std_ratio, bool *keep) const
+    {
+        const SpatialGrid<double> &grid = *grid_;
+        const size_t wanted = std::min((size_t)nb_neighbors, indexed_active_);
+        const double reach2 = cell_size_ * cell_size_;
+
+        // the active points around a cell are gathered once for all of its points, a point
+        // whose k-th neighbour may lie beyond them takes the per-point search instead
+        std::vector<double> mean_distances(size(), -1.0);
+        parallelFor(grid.cellCount(), num_threads_, [&](size_t begin, size_t end) {
+            std::vector<double> xs, ys, zs, nearest;
+            for (size_t c = begin; c < end; c++)
+            {
+                const double *first = grid.point(*grid.cellBegin(c));
+                xs.clear();
+                ys.clear();
+                zs.clear();
+                grid.forEachCandidate(first, 1, [&](uint32_t j) {
+                    if (active_[j])
+                    {
+                        xs.push_back(point(j)[0]);
+                        ys.push_back(point(j)[1]);
+                        zs.push_back(point(j)[2]);
+                    }
+                });
+
+                for (const uint32_t *it = grid.cellBegin(c); it != grid.cellEnd(c); ++it)
+                {
+                    if (!active_[*it])
+                    {
+                        continue;
+                    }
+                    const double *p = point(*it);
+
+                    bool found = false;
+                    if (xs.size() >= wanted && grid.sameCell(p, first))
+                    {
+                        nearest.resize(xs.size());
+                        for (size_t k = 0; k < xs.size(); k++)
+                        {
+                            const double dx = xs[k] - p[0], dy = ys[k] - p[1], dz = zs[k] - p[2];
+                            nearest[k] = dx * dx + dy * dy + dz * dz;
+                        }
+                        std::nth_element(nearest.begin(), nearest.begin() + (wanted - 1), nearest.end());
+                        nearest.resize(wanted);
+                        std::sort(nearest.begin(), nearest.end());
+                        found = nearest.back() <= reach2;
+                    }
+                    if (!found)
+                    {
+                        nearestDistances(p, wanted, nearest);
+                    }
+
+                    // ascending like the distances of a k-d tree search
+                    double sum = 0;
+                    for (double d2 : nearest)
+                    {
+                        sum += std::sqrt(d2);
+                    }
+                    mean_distances[*it] = sum / nearest.size();
+                }
+            }
+        });
+
+        // sequential sums in point order, like open3d
+        size_t valid = 0;
+        double cloud_mean = 0;
+        for (size_t i = 0; i < size(); i++)
+        {
+            if (active_[i] && grid_->cellOf(i) != SpatialGrid<double>::NO_CELL)
+            {
+                valid++;
+                cloud_mean += mean_distances[i] > 0 ? mean_distances[i] : 0;
+            }
+        }
+        cloud_mean /= valid;
+
+        double sq_sum = 0;
+        for (size_t i = 0; i < size(); i++)
+        {
+            if (mean_distances[i] > 0)
+            {
+                sq_sum += (mean_distances[i] - cloud_mean) * (mean_distances[i] - cloud_mean);
+            }
+        }
+        const double std_dev = std::sqrt(sq_sum / (valid - 1.0));
+        const double threshold = cloud_mean + std_ratio * std_dev;
+
+        for (size_t i = 0; i < size(); i++)
+        {
+            keep[i] = mean_distances[i] > 0 && mean_distances[i] < threshold;
+        }
+    }
+
+    /**
+     * @brief Normals from the active neighbours within `radius` (at most the max_nn nearest),
+     *        like open3d's estimate_normals with KDTreeSearchParamHybrid
+     * @note Points with fewer than 3 neighbours (self included) get (0, 0, 1) as in open3d.
+     *       Normals are not oriented.
+     */
+    void estimateNormalsInto(double radius, int max_nn, double *normals) const
+    {
+        const int rings = ringsFor(radius);
+        const double radius2 = radius * radius;
+
+        parallelFor(size(), num_threads_, [&](size_t begin, size_t end) {
+            std::vector<std::pair<double, uint32_t>> neighbours;
+            for (size_t i = begin; i < end; i++)
+            {
+                const double *p = point(i);
+                double *normal = normals + i * 3;
+                if (!active_[i])
+                {
+                    normal[0] = normal[1] = normal[2] = std::numeric_limits<double>::quiet_NaN();
+                    continue;
+                }
+
+                neighbours.clear();
+                grid_->forEachCandidate(p, rings, [&](uint32_t j) {
+                    if (!active_[j])
+                    {
+                        return;
+                    }
+                    const double *q = point(j);
+                    const double dx = q[0] - p[0], dy = q[1] - p[1], dz = q[2] - p[2];
+                    const double d2 = dx * dx + dy * dy + dz * dz;
+                    if (d2 < radius2)
+                    {
+                        neighbours.emplace_back(d2, j);
+                    }
+                });
+                if (max_nn > 0 && neighbours.size() > (size_t)max_nn)
+                {
+                    std::nth_element(neighbours.begin(), neighbours.begin() + max_nn, neighbours.end());
+                    neighbours.resize(max_nn);
+                }
+
+                if (neighbours.size() < 3)
+                {
+                    normal[0] = 0;
+                    normal[1] = 0;
+                    normal[2] = 1;
+                    continue;
+                }
+
+                // covariance around the neighbourhood mean
+                double mean[3] = {0, 0, 0};
+                for (const auto &nb : neighbours)
+                {
+                    const double *q = point(nb.second);
+                    mean[0] += q[0];
+                    mean[1] += q[1];
+                    mean[2] += q[2];
+                }
+                const double inv = 1.0 / neighbours.size();
+                mean[0] *= inv;
+                mean[1] *= inv;
+                mean[2] *= inv;
+
+                double cov[6] = {0, 0, 0, 0, 0, 0};
+                for (const auto &nb : neighbours)
+                {
+                    const double *q = point(nb.second);
+                    const double dx = q[0] - mean[0], dy = q[1] - mean[1], dz = q[2] - mean[2];
+                    cov[0] += dx * dx;
+                    cov[1] += dx * dy;
+                    cov[2] += dx * dz;
+                    cov[3] += dy * dy;
+                    cov[4] += dy * dz;
+                    cov[5] += dz * dz;
+                }
+
+                smallestEigenvector(cov, normal);
+            }
+        });
+    }
+
+    /**
+     * @brief Mask of the active points whose normal is within degrees_threshold of the Z axis
+     */
+    void horizontalPlaneMaskInto(double radius, int max_nn, double degrees_threshold, bool *keep) const
+    {
+        std::vector<double> normals(size() * 3);
+        estimateNormalsInto(radius, max_nn, normals.data());
+
+        // NaN normals of inactive points fail the comparison
+        const double cos_threshold = std::cos(M_PI / 180 * degrees_threshold);
+        for (size_t i = 0; i < size(); i++)
+        {
+            keep[i] = std::fabs(normals[i * 3 + 2]) > cos_threshold;
+        }
+    }
+
+private:
+    // Rings of cells holding every point within radius
+    int ringsFor(double radius) const
+    {
+        return std::max(1, (int)std::ceil(radius / cell_size_));
+    }
+
+    // Squared distances from the indexed point p to its `wanted` (at most the number of indexed
+    // active points) nearest active points, ascending. Shells of cells are scanned outwards until
+    // no unvisited point can be closer than the farthest one kept; once the shells outgrow the
+    // grid every point is scanned directly.
+    void nearestDistances(const double *p, size_t wanted, std::vector<double> &nearest) const
+    {
+        const SpatialGrid<double> &grid = *grid_;
+        size_t visited = 0;
+        nearest.clear();
+
+        auto scanCell = [&](uint32_t c) {
+            for (const uint32_t *it = grid.cellBegin(c); it != grid.cellEnd(c); ++it)
+            {
+                if (active_[*it])
+                {
+                    const double *q = point(*it);
+                    const double dx = q[0] - p[0], dy = q[1] - p[1], dz = q[2] - p[2];
+                    nearest.push_back(dx * dx + dy * dy + dz * dz);
+                    visited++;
+                }
+            }
+        };
+
+        for (int ring = 0; visited < indexed_active_; ring++)
+        {
+            const double side = 2.0 * ring + 1;
+            if (side * side * side > (double)grid.cellCount())
+            {
+                nearest.clear();
+                for (size_t c = 0; c < grid.cellCount(); c++)
+                {
+                    scanCell(c);
+                }
+                break;
+            }
+
+            grid.forEachCellInShell(p, ring, scanCell);
+
+            // keep the best `wanted` candidates, the k-th one last
+            if (nearest.size() >= wanted)
+            {
+                std::nth_element(nearest.begin(), nearest.begin() + (wanted - 1), nearest.end());
+                nearest.resize(wanted);
+
+                // points beyond this shell are more than ring cells away along some axis
+                const double reach = ring * cell_size_;
+                if (nearest.back() <= reach * reach)
+                {
+                    break;
+                }
+            }
+        }
+
+        if (nearest.size() > wanted)
+        {
+            std::nth_element(nearest.begin(), nearest.begin() + (wanted - 1), nearest.end());
+            nearest.resize(wanted);
+        }
+        std::sort(nearest.begin(), nearest.end());
+    }
+
+    std::vector<double> points_;
+    double cell_size_;
+    int num_threads_;
+    std::unique_ptr<SpatialGrid<double>> grid_;
+    std::vector<uint8_t> active_;
+    size_t active_count_ = 0;
+    size_t indexed_ = 0;        // points with finite coordinates
+    size_t indexed_active_ = 0; // active points with finite coordinates
+};
+
+// Inliers (points strictly closer than threshold) of the plane a x + b y + c z + d = 0 with a unit
+// normal, and the MSAC cost: the squared distances of the inliers plus threshold^2 per outlier
+inline size_t scorePlane(const float *x, const float *y, const float *z, size_t n, const float plane[4],
+                         float threshold, double &cost)
+{
+    size_t count = 0;
+    float sum = 0;
+    size_t i = 0;
+
+#if defined(POINT_CLOUD_OPS_SSE2)
+    const __m128 a = _mm_set1_ps(plane[0]);
+    const __m128 b = _mm_set1_ps(plane[1]);
+    const __m128 c = _mm_set1_ps(plane[2]);
+    const __m128 d = _mm_set1_ps(plane[3]);
+    const __m128 t = _mm_set1_ps(threshold);
+    const __m128 t2 = _mm_set1_ps(threshold * threshold);
+    const __m128 abs_mask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+    __m128 sums = _mm_setzero_ps();
+    for (; i + 4 <= n; i += 4)
+    {
+        const __m128 dist = _mm_and_ps(abs_mask, _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(a, _mm_loadu_ps(x + i)),
+                                                                                    _mm_mul_ps(b, _mm_loadu_ps(y + i))),
+                                                                         _mm_mul_ps(c, _mm_loadu_ps(z + i))),
+                                                              d));
+        const __m128 inlier = _mm_cmplt_ps(dist, t);
+        count += __builtin_popcount(_mm_movemask_ps(inlier));
+        sums = _mm_add_ps(sums, _mm_or_ps(_mm_and_ps(inlier, _mm_mul_ps(dist, dist)), _mm_andnot_ps(inlier, t2)));
+    }
+    alignas(16) float lanes[4];
+    _mm_store_ps(lanes, sums);
+    sum = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+#elif defined(POINT_CLOUD_OPS_NEON)
+    const float32x4_t a = vdupq_n_f32(plane[0]);
+    const float32x4_t b = vdupq_n_f32(plane[1]);
+    const float32x4_t c = vdupq_n_f32(plane[2]);
+    const float32x4_t d = vdupq_n_f32(plane[3]);
+    const float32x4_t t = vdupq_n_f32(threshold);
+    const float32x4_t t2 = vdupq_n_f32(threshold * threshold);
+    const uint32x4_t one = vdupq_n_u32(1);
+    uint32x4_t counts = vdupq_n_u32(0);
+    float32x4_t sums = vdupq_n_f32(0);
+    for (; i + 4 <= n; i += 4)
+    {
+        const float32x4_t dist = vabsq_f32(vaddq_f32(vaddq_f32(vaddq_f32(vmulq_f32(a, vld1q_f32(x + i)),
+                                                                          vmulq_f32(b, vld1q_f32(y + i))),
+                                                                vmulq_f32(c, vld1q_f32(z + i))),
+                                                      d));
+        const uint32x4_t inlier = vcltq_f32(dist, t);
+        counts = vaddq_u32(counts, vandq_u32(inlier, one));
+        sums = vaddq_f32(sums, vbslq_f32(inlier, vmulq_f32(dist, dist), t2));
+    }
+    count += vaddvq_u32(counts);
+    sum = vaddvq_f32(sums);
+#endif
+
+    for (; i < n; i++)
+    {
+        const float dist = std::fabs(plane[0] * x[i] + plane[1] * y[i] + plane[2] * z[i] + plane[3]);
+        if (dist < threshold)
+        {
+            count++;
+            sum += dist * dist;
+        }
+        else
+        {
+            sum += threshold * threshold;
+        }
+    }
+    cost = sum;
+    return count;
+}
+
+typedef struct
+{
+    double model[4];     // a x + b y + c z + d = 0, unit normal with c >= 0
+    size_t inliers;      // points strictly closer than the threshold to the plane
+    double tilt_degrees; // angle between the normal and the Z axis
+    int iterations;      // hypotheses drawn
+    bool degenerate;     // every sample was collinear, no plane was fitted and model is the z = 0 default
+} PlaneFit;
+
+/**
+ * @brief MSAC plane fit over finite points stored as columns, refined by least squares
+ * @note Hypotheses from 3 random points are ranked by their MSAC cost. The number of
+ *       iterations shrinks like open3d's segment_plane: log(1 - probability) /
+ *       log(1 - inlier_ratio^3), capped by max_iterations. The best hypothesis is then
+ *       refitted to its inliers (smallest principal axis through their centroid) and the
+ *       inliers are counted again against the refined plane. When every sample drawn is
+ *       collinear no hypothesis is scored, the fit is then degenerate with 0 inliers.
+ */
+inline PlaneFit fitPlaneInto(const float *x, const float *y, const float *z, size_t n, float threshold,
+                             int max_iterations, double probability, uint32_t seed)
+{
+    PlaneFit fit = {{0, 0, 1, 0}, 0, 0, 0, false};
+    std::mt19937 rng(seed);
+    std::uniform_int_distribution<size_t> pick(0, n - 1);
+
+    double best_cost = std::numeric_limits<double>::infinity();
+    float best[4] = {0, 0, 1, 0};
+    double needed = max_iterations;
+    for (int it = 0; it < max_iterations && it < needed; it++)
+    {
+        fit.iterations++;
+
+        size_t s[3];
+        s[0] = pick(rng);
+        do
+        {
+            s[1] = pick(rng);
+        } while (s[1] == s[0]);
+        do
+        {
+            s[2] = pick(rng);
+        } while (s[2] == s[0] || s[2] == s[1]);
+
+        const double u[3] = {(double)x[s[1]] - x[s[0]], (double)y[s[1]] - y[s[0]], (double)z[s[1]] - z[s[0]]};
+        const double v[3] = {(double)x[s[2]] - x[s[0]], (double)y[s[2]] - y[s[0]], (double)z[s[2]] - z[s[0]]};
+        double normal[3];
+        cross(u, v, normal);
+        const double length = std::sqrt(norm2(normal));
+        if (!(length > 0))
+        {
+            // collinear sample
+            continue;
+        }
+        const float plane[4] = {(float)(normal[0] / length), (float)(normal[1] / length), (float)(normal[2] / length),
+                                (float)(-(normal[0] * x[s[0]] + normal[1] * y[s[0]] + normal[2] * z[s[0]]) / length)};
+
+        double cost;
+        const size_t inliers = scorePlane(x, y, z, n, plane, threshold, cost);
+        if (cost < best_cost || (cost == best_cost && inliers > fit.inliers))
+        {
+            best_cost = cost;
+            std::copy(plane, plane + 4, best);
+            fit.inliers = inliers;
+
+            const double ratio = (double)inliers / n;
+            if (ratio >= 1)
+            {
+                break;
+            }
+            if (ratio > 0)
+            {
+                needed = std::log(1 - probability) / std::log(1 - ratio * ratio * ratio);
+            }
+        }
+    }
+
+    if (best_cost == std::numeric_limits<double>::infinity())
+    {
+        fit.degenerate = true;
+        return fit;
+    }
+
+    // least squares refit to the inliers of the best hypothesis
+    double mean[3] = {0, 0, 0};
+    size_t count = 0;
+    for (size_t i = 0; i < n; i++)
+    {
+        if (std::fabs(best[0] * x[i] + best[1] * y[i] + best[2] * z[i] + best[3]) < threshold)
+        {
+            mean[0] += x[i];
+            mean[1] += y[i];
+            mean[2] += z[i];
+            count++;
+        }
+    }
+
+    double model[4] = {best[0], best[1], best[2], best[3]};
+    if (count >= 3)
+    {
+        mean[0] /= count;
+        mean[1] /= count;
+        mean[2] /= count;
+
+        double cov[6] = {0, 0, 0, 0, 0, 0};
+        for (size_t i = 0; i < n; i++)
+        {
+            if (std::fabs(best[0] * x[i] + best[1] * y[i] + best[2] * z[i] + best[3]) < threshold)
+            {
+                const double dx = x[i] - mean[0], dy = y[i] - mean[1], dz = z[i] - mean[2];
+                cov[0] += dx * dx;
+                cov[1] += dx * dy;
+                cov[2] += dx * dz;
+                cov[3] += dy * dy;
+                cov[4] += dy * dz;
+                cov[5] += dz * dz;
+            }
+        }
+
+        double normal[3];
+        smallestEigenvector(cov, normal);
+        if (norm2(normal) > 0)
+        {
+            model[0] = normal[0];
+            model[1] = normal[1];
+            model[2] = normal[2];
+            model[3] = -(normal[0] * mean[0] + normal[1] * mean[1] + normal[2] * mean[2]);
+
+            const float refined[4] = {(float)model[0], (float)model[1], (float)model[2], (float)model[3]};
+            double cost;
+            fit.inliers = scorePlane(x, y, z, n, refined, threshold, cost);
+        }
+    }
+
+    // the sign of a plane is arbitrary, point the normal along +Z
+    const double sign = model[2] < 0 ? -1.0 : 1.0;
+    for (int k = 0; k < 4; k++)
+    {
+        fit.model[k] = sign * model[k];
+    }
+    fit.tilt_degrees = std::acos(std::min(1.0, fit.model[2])) * 180 / M_PI;
+    return fit;
+}
@@ -0,0 +1,226 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include "unitree_lidar_utilities.h"
+
+namespace unilidar_sdk2{
+
+/**
+ * @brief Settings of the native acquisition pipeline
+ * @note Thresholds are kept in double and compared against the float coordinates
+ *       widened to double, exactly like the numpy masks they replace.
+ */
+typedef struct
+{
+    double length = std::numeric_limits<double>::infinity();                 // keep |x| < length and |y| < length
+    double below_lidar_threshold = -std::numeric_limits<double>::infinity(); // keep z > below_lidar_threshold
+    float range_min = 0;   // allowed minimum point range in meters
+    float range_max = 100; // allowed maximum point range in meters
+    bool deskew = false;   // rotate every point into the IMU orientation at the cloud stamp
+} PointCloudPipelineConfig;
+
+/**
+ * @brief Packet stage of the native acquisition pipeline: projection, de-skew and crop
+ * @note Packets are projected into a fixed scratch buffer and only the points kept
+ *       by the crop are appended to the output, so discarded points are never
+ *       stored in a cloud. One instance must only be used by one thread at a time.
+ *
+ *       With deskew enabled, each point is rotated from the sensor orientation at its
+ *       own time into the orientation at the cloud stamp, before the crop. Orientations
+ *       are interpolated from the IMU samples given to addOrientation(), which must be
+ *       stamped with the clock of the cloud stamps. Only the rotation is compensated,
+ *       which is what a vibrating but fixed mount needs, and the IMU axes are assumed
+ *       to be those of the point cloud.
+ */
+class PointCloudPipeline
+{
+public:
+    explicit PointCloudPipeline(const PointCloudPipelineConfig &config = PointCloudPipelineConfig())
+        : config_(config)
+    {
+    }
+
+    const PointCloudPipelineConfig &config() const { return config_; }
+
+    /**
+     * @brief Record the sensor orientation (x, y, z, w) at stamp, stamps must not decrease
+     * @note Only the last ORIENTATION_HISTORY samples are kept.
+     */
+    void addOrientation(double stamp, const float quaternion[4])
+    {
+        Orientation &o = orientations_[(orientation_head_ + orientation_count_) % ORIENTATION_HISTORY];
+        o.stamp = orientation_count_ > 0 ? std::max(stamp, orientationAt(orientation_count_ - 1).stamp) : stamp;
+        for (int k = 0; k < 4; k++)
+        {
+            o.q[k] = quaternion[k];
+        }
+        if (orientation_count_ < ORIENTATION_HISTORY)
+        {
+            orientation_count_++;
+        }
+        else
+        {
+            orientation_head_ = (orientation_head_ + 1) % ORIENTATION_HISTORY;
+        }
+    }
+
+    void clearOrientations()
+    {
+        orientation_head_ = 0;
+        orientation_count_ = 0;
+    }
+
+    /**
+     * @brief Project the points of a packet and append those kept by the crop to cloud
+     * @param[in] time_offset added to the point times, i.e. packet stamp - cloud stamp
+     * @return number of points appended
+     */
+    int append(PointCloudSoA &cloud, const LidarPointDataPacket &packet, float time_offset = 0)
+    {
+        const ProjectionKernelOutput out = {scratch_x_, scratch_y_, scratch_z_, scratch_intensity_, scratch_time_};
+        const int num = projector_.project(out, packet.data, config_.range_min, config_.range_max);
+        if (config_.deskew && orientation_count_ > 0)
+        {
+            deskew(num, cloud.stamp, cloud.stamp + time_offset);
+        }
+
+        int kept = 0;
+        for (int k = 0; k < num; k++)
+        {
+            kept += keep(scratch_x_[k], scratch_y_[k], scratch_z_[k]);
+        }
+
+        const size_t offset = cloud.size();
+        cloud.resize(offset + kept);
+        size_t j = offset;
+        for (int k = 0; k < num; k++)
+        {
+            if (keep(scratch_x_[k], scratch_y_[k], scratch_z_[k]))
+            {
+                cloud.x[j] = scratch_x_[k];
+                cloud.y[j] = scratch_y_[k];
+                cloud.z[j] = scratch_z_[k];
+                cloud.intensity[j] = scratch_intensity_[k];
+                cloud.time[j] = scratch_time_[k] + time_offset;
+                j++;
+            }
+        }
+        return kept;
+    }
+
+    static constexpr size_t ORIENTATION_HISTORY = 512;
+
+private:
+    typedef struct
+    {
+        double stamp;
+        double q[4]; // x, y, z, w
+    } Orientation;
+
+    const Orientation &orientationAt(size_t i) const
+    {
+        return orientations_[(orientation_head_ + i) % ORIENTATION_HISTORY];
+    }
+
+    /**
+     * @brief Orientation at stamp, normalized linear interpolation between the two
+     *        surrounding samples and held constant outside of the history
+     */
+    void interpolate(double stamp, double q[4]) const
+    {
+        size_t lo = 0, hi = orientation_count_;
+        while (lo < hi)
+        {
+            const size_t mid = (lo + hi) / 2;
+            if (orientationAt(mid).stamp < stamp)
+            {
+                lo = mid + 1;
+            }
+            else
+            {
+                hi = mid;
+            }
+        }
+
+        if (lo == 0 || lo == orientation_count_)
+        {
+            const Orientation &o = orientationAt(lo == 0 ? 0 : orientation_count_ - 1);
+            std::copy(o.q, o.q + 4, q);
+            return;
+        }
+
+        const Orientation &a = orientationAt(lo - 1);
+        const Orientation &b = orientationAt(lo);
+        const double span = b.stamp - a.stamp;
+        const double t = span > 0 ? (stamp - a.stamp) / span : 1.0;
+        // q and -q are the same rotation, interpolate along the shorter arc
+        const double dot = a.q[0] * b.q[0] + a.q[1] * b.q[1] + a.q[2] * b.q[2] + a.q[3] * b.q[3];
+        const double sign = dot < 0 ? -1.0 : 1.0;
+        double length = 0;
+        for (int k = 0; k < 4; k++)
+        {
+            q[k] = (1 - t) * a.q[k] + t * sign * b.q[k];
+            length += q[k] * q[k];
+        }
+        length = std::sqrt(length);
+        for (int k = 0; k < 4; k++)
+        {
+            q[k] /= length;
+        }
+    }
+
+    /**
+     * @brief Rotate the scratch points from the orientation at their time into the
+     *        orientation at cloud_stamp, point times being relative to packet_stamp
+     */
+    void deskew(int num, double cloud_stamp, double packet_stamp)
+    {
+        double ref[4];
+        interpolate(cloud_stamp, ref);
+
+        for (int k = 0; k < num; k++)
+        {
+            double q[4];
+            interpolate(packet_stamp + scratch_time_[k], q);
+
+            // r = conj(ref) * q, the rotation from the point pose into the cloud pose
+            const double rx = ref[3] * q[0] - ref[0] * q[3] - ref[1] * q[2] + ref[2] * q[1];
+            const double ry = ref[3] * q[1] - ref[1] * q[3] - ref[2] * q[0] + ref[0] * q[2];
+            const double rz = ref[3] * q[2] - ref[2] * q[3] - ref[0] * q[1] + ref[1] * q[0];
+            const double rw = ref[3] * q[3] + ref[0] * q[0] + ref[1] * q[1] + ref[2] * q[2];
+
+            // p' = p + 2 w (v x p) + 2 v x (v x p)
+            const double px = scratch_x_[k], py = scratch_y_[k], pz = scratch_z_[k];
+            const double cx = 2 * (ry * pz - rz * py);
+            const double cy = 2 * (rz * px - rx * pz);
+            const double cz = 2 * (rx * py - ry * px);
+            scratch_x_[k] = (float)(px + rw * cx + (ry * cz - rz * cy));
+            scratch_y_[k] = (float)(py + rw * cy + (rz * cx - rx * cz));
+            scratch_z_[k] = (float)(pz + rw * cz + (rx * cy - ry * cx));
+        }
+    }
+
+    bool keep(float x, float y, float z) const
+    {
+        return std::fabs((double)x) < config_.length &&
+               std::fabs((double)y) < config_.length &&
+               (double)z > config_.below_lidar_threshold;
+    }
+
+    PointCloudPipelineConfig config_;
+    PointCloudProjector projector_;
+
+    Orientation orientations_[ORIENTATION_HISTORY];
+    size_t orientation_head_ = 0;
+    size_t orientation_count_ = 0;
+
+    alignas(32) float scratch_x_[PointCloudProjector::MAX_POINT_NUM + PROJECTION_KERNEL_SLACK];
+    alignas(32) float scratch_y_[PointCloudProjector::MAX_POINT_NUM + PROJECTION_KERNEL_SLACK];
+    alignas(32) float scratch_z_[PointCloudProjector::MAX_POINT_NUM + PROJECTION_KERNEL_SLACK];
+    alignas(32) float scratch_intensity_[PointCloudProjector::MAX_POINT_NUM + PROJECTION_KERNEL_SLACK];
+    alignas(32) float scratch_time_[PointCloudProjector::MAX_POINT_NUM + PROJECTION_KERNEL_SLACK];
+};
+
+} // end of namespace unilidar_sdk2
@@ -0,0 +1,231 @@
+#pragma once
+
+#include <stdint.h>
+#include <cmath>
+#include <limits>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @brief Uniform hash grid over the first (up to three) coordinates of a point set
+ * @note Points are bucketed by floor(coord / cell_size). Cell coordinates are packed
+ *       into a 64-bit key with 21 bits per axis; distinct cells that collide after
+ *       packing share a bucket, which only adds candidates and never hides one.
+ *       Points with a non-finite coordinate are kept out of every bucket.
+ */
+template <typename T>
+class SpatialGrid
+{
+public:
+    static constexpr uint32_t NO_CELL = std::numeric_limits<uint32_t>::max();
+
+    /**
+     * @param points row-major points, `stride` values per point
+     * @param n number of points
+     * @param stride number of values per point
+     * @param dims number of leading coordinates hashed, clamped to [0, 3]
+     * @param cell_size side of a cell, must be positive
+     */
+    SpatialGrid(const T *points, size_t n, size_t stride, int dims, double cell_size)
+        : points_(points), n_(n), stride_(stride),
+          dims_(dims < 0 ? 0 : (dims > 3 ? 3 : dims)), inv_cell_(1.0 / cell_size)
+    {
+        // bucket every point
+        point_cell_.assign(n_, NO_CELL);
+        std::vector<uint32_t> counts;
+        for (size_t i = 0; i < n_; i++)
+        {
+            int64_t c[3];
+            if (!cellCoords(points_ + i * stride_, c))
+            {
+                continue;
+            }
+
+            const uint64_t key = pack(c);
+            auto it = cell_index_.find(key);
+            if (it == cell_index_.end())
+            {
+                it = cell_index_.emplace(key, (uint32_t)counts.size()).first;
+                counts.push_back(0);
+            }
+            point_cell_[i] = it->second;
+            counts[it->second]++;
+        }
+
+        // counting sort of the point indices by bucket, ascending inside a bucket
+        cell_begin_.assign(counts.size() + 1, 0);
+        for (size_t c = 0; c < counts.size(); c++)
+        {
+            cell_begin_[c + 1] = cell_begin_[c] + counts[c];
+        }
+        order_.resize(cell_begin_.back());
+        std::vector<uint32_t> fill(cell_begin_.begin(), cell_begin_.end() - 1);
+        for (size_t i = 0; i < n_; i++)
+        {
+            if (point_cell_[i] != NO_CELL)
+            {
+                order_[fill[point_cell_[i]]++] = (uint32_t)i;
+            }
+        }
+    }
+
+    size_t size() const { return n_; }
+    int dims() const { return dims_; }
+
+    /**
+     * @brief Number of non-empty buckets, indexed [0, cellCount())
+     */
+    size_t cellCount() const { return cell_begin_.size() - 1; }
+
+    /**
+     * @brief Bucket of point i, NO_CELL for points with a non-finite coordinate
+     */
+    uint32_t cellOf(size_t i) const { return point_cell_[i]; }
+
+    const uint32_t *cellBegin(size_t c) const { return order_.data() + cell_begin_[c]; }
+    const uint32_t *cellEnd(size_t c) const { return order_.data() + cell_begin_[c + 1]; }
+
+    /**
+     * @brief Visit every bucket within `rings` cells of the cell containing p
+     * @param f called as f(bucket index), once per bucket
+     * @return false if p has a non-finite coordinate, nothing is visited then
+     */
+    template <typename F>
+    bool forEachNeighbourCell(const T *p, int rings, F f) const
+    {
+        int64_t c[3];
+        if (!cellCoords(p, c))
+        {
+            return false;
+        }
+
+        const int rx = dims_ > 0 ? rings : 0;
+        const int ry = dims_ > 1 ? rings : 0;
+        const int rz = dims_ > 2 ? rings : 0;
+        for (int dx = -rx; dx <= rx; dx++)
+        {
+            for (int dy = -ry; dy <= ry; dy++)
+            {
+                for (int dz = -rz; dz <= rz; dz++)
+                {
+                    const int64_t nc[3] = {c[0] + dx, c[1] + dy, c[2] + dz};
+                    auto it = cell_index_.find(pack(nc));
+                    if (it != cell_index_.end())
+                    {
+                        f(it->second);
+                    }
+                }
+            }
+        }
+        return true;
+    }
+
+    /**
+     * @brief Visit every bucket exactly `ring` cells (Chebyshev distance) away from the
+     *        cell containing p, so growing rings visit every bucket once
+     * @param f called as f(bucket index)
+     * @return false if p has a non-finite coordinate, nothing is visited then
+     */
+    template <typename F>
+    bool forEachCellInShell(const T *p, int ring, F f) const
+    {
+        int64_t c[3];
+        if (!cellCoords(p, c))
+        {
+            return false;
+        }
+
+        const int rx = dims_ > 0 ? ring : 0;
+        const int ry = dims_ > 1 ? ring : 0;
+        const int rz = dims_ > 2 ? ring : 0;
+        for (int dx = -rx; dx <= rx; dx++)
+        {
+            for (int dy = -ry; dy <= ry; dy++)
+            {
+                const bool on_shell = ring == 0 || (rx > 0 && (dx == -rx || dx == rx)) || (ry > 0 && (dy == -ry || dy == ry));
+                // inside the shell only the two z faces remain
+                const int dz_step = on_shell ? 1 : 2 * rz;
+                if (!on_shell && rz == 0)
+                {
+                    continue;
+                }
+                for (int dz = -rz; dz <= rz; dz += dz_step)
+                {
+                    const int64_t nc[3] = {c[0] + dx, c[1] + dy, c[2] + dz};
+                    auto it = cell_index_.find(pack(nc));
+                    if (it != cell_index_.end())
+                    {
+                        f(it->second);
+                    }
+                }
+            }
+        }
+        return true;
+    }
+
+    /**
+     * @brief Visit every point in the buckets within `rings` cells of p
+     * @param f called as f(point index), the point p itself included if it is indexed
+     */
+    template <typename F>
+    bool forEachCandidate(const T *p, int rings, F f) const
+    {
+        return forEachNeighbourCell(p, rings, [&](uint32_t c) {
+            for (const uint32_t *it = cellBegin(c); it != cellEnd(c); ++it)
+            {
+                f(*it);
+            }
+        });
+    }
+
+    const T *point(size_t i) const { return points_ + i * stride_; }
+
+    /**
+     * @brief Whether a and b fall in the same cell, unlike sharing a bucket this is
+     *        never true for distinct cells whose keys collide
+     */
+    bool sameCell(const T *a, const T *b) const
+    {
+        int64_t ca[3], cb[3];
+        return cellCoords(a, ca) && cellCoords(b, cb) && ca[0] == cb[0] && ca[1] == cb[1] && ca[2] == cb[2];
+    }
+
+private:
+    bool cellCoords(const T *p, int64_t c[3]) const
+    {
+        // keep far away coordinates inside int64, the key wraps anyway
+        const double limit = 1e15;
+        for (int k = 0; k < 3; k++)
+        {
+            c[k] = 0;
+            if (k >= dims_)
+            {
+                continue;
+            }
+            const double v = std::floor((double)p[k] * inv_cell_);
+            if (!std::isfinite(v))
+            {
+                return false;
+            }
+            c[k] = (int64_t)(v < -limit ? -limit : (v > limit ? limit : v));
+        }
+        return true;
+    }
+
+    static uint64_t pack(const int64_t c[3])
+    {
+        const uint64_t mask = (1ull << 21) - 1;
+        return ((uint64_t)c[0] & mask) | (((uint64_t)c[1] & mask) << 21) | (((uint64_t)c[2] & mask) << 42);
+    }
+
+    const T *points_;
+    size_t n_;
+    size_t stride_;
+    int dims_;
+    double inv_cell_;
+
+    std::unordered_map<uint64_t, uint32_t> cell_index_; // packed key -> bucket
+    std::vector<uint32_t> cell_begin_;                  // bucket -> first slot in order_
+    std::vector<uint32_t> order_;                       // point indices grouped by bucket
+    std::vector<uint32_t> point_cell_;                  // point -> bucket
+};
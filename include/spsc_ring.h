@@ -0,0 +1,74 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief Fixed-capacity single-producer/single-consumer ring buffer
+ * @note push() must only be called from one thread and pop() from one (other) thread.
+ * @note Items are exchanged with std::swap, so the buffers of heavy items (e.g. point
+ *       vectors) are recycled between producer and consumer instead of reallocated.
+ */
+template <typename T>
+class SpscRing
+{
+public:
+    explicit SpscRing(size_t capacity) : slots_(capacity + 1) {}
+
+    SpscRing(const SpscRing &) = delete;
+    SpscRing &operator=(const SpscRing &) = delete;
+
+    /**
+     * @brief Swap item into the ring
+     * @return false if the ring is full, item is left untouched
+     */
+    bool push(T &item)
+    {
+        const size_t head = head_.load(std::memory_order_relaxed);
+        const size_t next = increment(head);
+        if (next == tail_.load(std::memory_order_acquire))
+        {
+            return false;
+        }
+        std::swap(slots_[head], item);
+        head_.store(next, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * @brief Swap the oldest item out of the ring
+     * @return false if the ring is empty
+     */
+    bool pop(T &item)
+    {
+        const size_t tail = tail_.load(std::memory_order_relaxed);
+        if (tail == head_.load(std::memory_order_acquire))
+        {
+            return false;
+        }
+        std::swap(item, slots_[tail]);
+        tail_.store(increment(tail), std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * @brief Approximate number of items, exact when called from producer or consumer
+     */
+    size_t size() const
+    {
+        const size_t head = head_.load(std::memory_order_acquire);
+        const size_t tail = tail_.load(std::memory_order_acquire);
+        return head >= tail ? head - tail : head + slots_.size() - tail;
+    }
+
+    size_t capacity() const { return slots_.size() - 1; }
+
+private:
+    size_t increment(size_t i) const { return i + 1 == slots_.size() ? 0 : i + 1; }
+
+    std::vector<T> slots_;
+    alignas(64) std::atomic<size_t> head_{0}; // written by producer
+    alignas(64) std::atomic<size_t> tail_{0}; // written by consumer
+};
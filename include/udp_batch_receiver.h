@@ -0,0 +1,664 @@
+#pragma once
+
+#include <errno.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <chrono>
+#include <string>
+#include <vector>
+#include "unitree_lidar_sdk.h"
+
+namespace unilidar_sdk2{
+
+/**
+ * @brief Receives the datagrams of a UDP socket in batches
+ * @note One recvmmsg() call fills up to batch slots of a packet arena allocated once,
+ *       so a burst of packets costs one syscall instead of one each. The socket asks
+ *       for a large SO_RCVBUF (SO_RCVBUFFORCE first, which ignores net.core.rmem_max
+ *       when the process has CAP_NET_ADMIN) so bursts wait in the kernel rather than
+ *       being dropped. With kernel timestamps every datagram carries the CLOCK_REALTIME
+ *       at which it reached the socket (SO_TIMESTAMPNS), otherwise the time of the
+ *       recvmmsg() call that returned it.
+ *       The slots stay valid until the next receive(). Linux only.
+ */
+class UdpBatchReceiver
+{
+public:
+    static const size_t SLOT_SIZE = 8192; // larger than any packet of the protocol
+
+    ~UdpBatchReceiver() { close(); }
+
+    /**
+     * @brief Create the socket and bind it to local_ip:local_port
+     * @param batch most datagrams returned by one receive()
+     * @param receive_buffer requested SO_RCVBUF in bytes, see receiveBufferSize()
+     * @param kernel_timestamps stamp the datagrams in the kernel
+     * @return 0 on success, -1 if the socket can not be created or bound
+     */
+    int open(unsigned short local_port, const std::string &local_ip, size_t batch = 64,
+             int receive_buffer = 8 << 20, bool kernel_timestamps = true)
+    {
+        close();
+        sockfd_ = socket(AF_INET, SOCK_DGRAM, 0);
+        if (sockfd_ < 0)
+        {
+            return -1;
+        }
+
+        if (setsockopt(sockfd_, SOL_SOCKET, SO_RCVBUFFORCE, &receive_buffer, sizeof(receive_buffer)) < 0)
+        {
+            setsockopt(sockfd_, SOL_SOCKET, SO_RCVBUF, &receive_buffer, sizeof(receive_buffer));
+        }
+        socklen_t length = sizeof(receive_buffer_);
+        getsockopt(sockfd_, SOL_SOCKET, SO_RCVBUF, &receive_buffer_, &length);
+
+        const int on = 1;
+        kernel_timestamps_ = kernel_timestamps && setsockopt(sockfd_, SOL_SOCKET, SO_TIMESTAMPNS, &on, sizeof(on)) == 0;
+
+        sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(local_port);
+        if (local_ip.empty() || inet_pton(AF_INET, local_ip.c_str(), &addr.sin_addr) != 1 ||
+            bind(sockfd_, (const sockaddr *)&addr, sizeof(addr)) < 0)
+        {
+            // like UDPHandler, fall back to every interface when the address is not ours
+            addr.sin_addr.s_addr = htonl(INADDR_ANY);
+            if (bind(sockfd_, (const sockaddr *)&addr, sizeof(addr)) < 0)
+            {
+                close();
+                return -1;
+            }
+        }
+
+        batch = batch > 0 ? batch : 1;
+        arena_.assign(batch * SLOT_SIZE, 0);
+        control_.assign(batch * CONTROL_SIZE, 0);
+        iovecs_.resize(batch);
+        messages_.resize(batch);
+        stamps_.resize(batch);
+        count_ = 0;
+        return 0;
+    }
+
+    void close()
+    {
+        if (sockfd_ >= 0)
+        {
+            ::close(sockfd_);
+            sockfd_ = -1;
+        }
+        count_ = 0;
+    }
+
+    bool isOpen() const { return sockfd_ >= 0; }
+
+    /**
+     * @brief Replace the previous batch with the datagrams waiting on the socket
+     * @return number of datagrams received, 0 if none was waiting, -1 on error
+     * @note Never blocks. Datagrams cut by the slot size are dropped and counted.
+     */
+    int receive()
+    {
+        count_ = 0;
+        if (sockfd_ < 0)
+        {
+            return -1;
+        }
+
+        const size_t batch = messages_.size();
+        for (size_t i = 0; i < batch; i++)
+        {
+            iovecs_[i].iov_base = &arena_[i * SLOT_SIZE];
+            iovecs_[i].iov_len = SLOT_SIZE;
+            msghdr &header = messages_[i].msg_hdr;
+            memset(&header, 0, sizeof(header));
+            header.msg_iov = &iovecs_[i];
+            header.msg_iovlen = 1;
+            if (kernel_timestamps_)
+            {
+                header.msg_control = &control_[i * CONTROL_SIZE];
+                header.msg_controllen = CONTROL_SIZE;
+            }
+        }
+
+        const int received = recvmmsg(sockfd_, messages_.data(), batch, MSG_DONTWAIT, nullptr);
+        if (received < 0)
+        {
+            return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR ? 0 : -1;
+        }
+        const double now = getSystemTimeStamp();
+
+        for (int i = 0; i < received; i++)
+        {
+            const msghdr &header = messages_[i].msg_hdr;
+            if (header.msg_flags & MSG_TRUNC)
+            {
+                truncated_++;
+                continue;
+            }
+
+            // compact the batch, slot count_ takes the datagram of slot i
+            if ((size_t)i != count_)
+            {
+                memcpy(&arena_[count_ * SLOT_SIZE], &arena_[i * SLOT_SIZE], messages_[i].msg_len);
+                messages_[count_].msg_len = messages_[i].msg_len;
+            }
+            stamps_[count_] = kernel_timestamps_ ? kernelStamp(header, now) : now;
+            count_++;
+        }
+
+        datagrams_ += count_;
+        batches_++;
+        return (int)count_;
+    }
+
+    /**
+     * @brief Send a datagram from the bound socket
+     * @return bytes sent, -1 on error
+     */
+    int send(const void *buf, size_t size, const std::string &ip, unsigned short port)
+    {
+        sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(port);
+        if (sockfd_ < 0 || inet_pton(AF_INET, ip.c_str(), &addr.sin_addr) != 1)
+        {
+            return -1;
+        }
+        return (int)sendto(sockfd_, buf, size, 0, (const sockaddr *)&addr, sizeof(addr));
+    }
+
+    /// Datagrams of the last batch
+    size_t count() const { return count_; }
+
+    const uint8_t *data(size_t i) const { return &arena_[i * SLOT_SIZE]; }
+
+    size_t size(size_t i) const { return messages_[i].msg_len; }
+
+    /// Receive time of datagram i [s], CLOCK_REALTIME like getSystemTimeStamp()
+    double stamp(size_t i) const { return stamps_[i]; }
+
+    /// SO_RCVBUF granted by the kernel, which reports twice the usable bytes
+    int receiveBufferSize() const { return receive_buffer_; }
+
+    bool kernelTimestamps() const { return kernel_timestamps_; }
+
+    uint64_t datagrams() const { return datagrams_; }
+
+    uint64_t batches() const { return batches_; }
+
+    uint64_t truncated() const { return truncated_; }
+
+private:
+    static const size_t CONTROL_SIZE = CMSG_SPACE(sizeof(timespec));
+
+    static double kernelStamp(const msghdr &header, double fallback)
+    {
+        for (const cmsghdr *cmsg = CMSG_FIRSTHDR(&header); cmsg != nullptr;
+             cmsg = CMSG_NXTHDR(const_cast<msghdr *>(&header), const_cast<cmsghdr *>(cmsg)))
+        {
+            if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_TIMESTAMPNS)
+            {
+                timespec stamp;
+                memcpy(&stamp, CMSG_DATA(cmsg), sizeof(stamp));
+                return stamp.tv_sec + stamp.tv_nsec / 1.0e9;
+            }
+        }
+        return fallback;
+    }
+
+    int sockfd_ = -1;
+    int receive_buffer_ = 0;
+    bool kernel_timestamps_ = false;
+
+    // one slot of SLOT_SIZE bytes and one control message per datagram of a batch
+    std::vector<uint8_t> arena_;
+    std::vector<uint8_t> control_;
+    std::vector<iovec> iovecs_;
+    std::vector<mmsghdr> messages_;
+    std::vector<double> stamps_;
+    size_t count_ = 0;
+
+    uint64_t datagrams_ = 0;
+    uint64_t batches_ = 0;
+    uint64_t truncated_ = 0;
+};
+
+/**
+ * @brief UDP reader which parses the packets of a UdpBatchReceiver
+ * @note A drop-in UnitreeLidarReader for the UDP board: runParse() still returns one
+ *       packet per call, but the packets come from the batch of the last recvmmsg()
+ *       and the socket is only read again once the batch is parsed. Datagrams which
+ *       are not one well formed packet (header, size, tail, crc) are skipped.
+ *       With use_system_timestamp the point packets are stamped with their receive
+ *       time, the kernel one when available, so the stamps do not depend on how long
+ *       a packet waited in its batch.
+ *       Once a second runParse() also sends a latency probe (the one-way delay is half
+ *       its round trip) and, until the lidar answered, a version request.
+ */
+class UdpBatchLidarReader : public UnitreeLidarReader
+{
+public:
+    /**
+     * @param batch most datagrams read per syscall
+     * @param receive_buffer requested socket receive buffer in bytes
+     * @param kernel_timestamps stamp the packets when they reach the socket
+     */
+    explicit UdpBatchLidarReader(size_t batch = 64, int receive_buffer = 8 << 20, bool kernel_timestamps = true)
+        : batch_(batch), receive_buffer_(receive_buffer), kernel_timestamps_(kernel_timestamps)
+    {
+    }
+
+    int initializeSerial(std::string, uint32_t, uint16_t, bool, float, float) override { return -1; }
+
+    int initializeUDP(unsigned short lidar_port = 6101, std::string lidar_ip = "192.168.1.62",
+                      unsigned short local_port = 6201, std::string local_ip = "192.168.1.2",
+                      uint16_t cloud_scan_num = 18, bool use_system_timestamp = true, float range_min = 0,
+                      float range_max = 100) override
+    {
+        if (receiver_.open(local_port, local_ip, batch_, receive_buffer_, kernel_timestamps_))
+        {
+            return -1;
+        }
+
+        lidar_ip_ = lidar_ip;
+        lidar_port_ = lidar_port;
+        cloud_scan_num_ = cloud_scan_num > 0 ? cloud_scan_num : 1;
+        use_system_timestamp_ = use_system_timestamp;
+        range_min_ = range_min;
+        range_max_ = range_max;
+        cursor_ = 0;
+        clearBuffer();
+        cloud_count_ = 0;
+
+        has_imu_ = has_version_ = has_delay_ = has_dirty_ = false;
+        next_probe_ = std::chrono::steady_clock::now();
+        return 0;
+    }
+
+    bool closeSerial() override { return false; }
+
+    bool closeUDP() override
+    {
+        if (!receiver_.isOpen())
+        {
+            return false;
+        }
+        receiver_.close();
+        return true;
+    }
+
+    int runParse() override
+    {
+        cloud_ready_ = false;
+        if (cursor_ >= receiver_.count())
+        {
+            probe();
+            cursor_ = 0;
+            if (receiver_.receive() <= 0)
+            {
+                return 0;
+            }
+        }
+
+        while (cursor_ < receiver_.count())
+        {
+            const size_t i = cursor_++;
+            const int result = parsePacket(receiver_.data(i), receiver_.size(i), receiver_.stamp(i));
+            if (result != 0)
+            {
+                last_stamp_ = receiver_.stamp(i);
+                return result;
+            }
+        }
+        return 0;
+    }
+
+    /**
+     * @brief Drop the point cloud under construction and the rest of the batch
+     */
+    void clearBuffer() override
+    {
+        cursor_ = receiver_.count();
+        building_.points.clear();
+        building_packets_ = 0;
+    }
+
+    const LidarPointDataPacket &getLidarPointDataPacket() const override { return point_packet_; }
+
+    const Lidar2DPointDataPacket &getLidar2DPointDataPacket() const override { return point_2d_packet_; }
+
+    const LidarImuDataPacket &getLidarImuDataPacket() const override { return imu_packet_; }
+
+    const LidarVersionDataPacket &getLidarVersionDataPacket() const override { return version_packet_; }
+
+    /**
+     * @brief The point cloud completed by the last runParse(), if any
+     */
+    bool getPointCloud(PointCloudUnitree &cloud) const override
+    {
+        if (!cloud_ready_)
+        {
+            return false;
+        }
+        cloud = cloud_;
+        return true;
+    }
+
+    bool getImuData(LidarImuData &imu) const override
+    {
+        if (!has_imu_)
+        {
+            return false;
+        }
+        imu = imu_packet_.data;
+        return true;
+    }
+
+    bool getVersionOfSDK(std::string &version) const override
+    {
+        version = "batched udp";
+        return true;
+    }
+
+    bool getVersionOfLidarFirmware(std::string &version) const override
+    {
+        if (!has_version_)
+        {
+            return false;
+        }
+        version = formatVersion(version_packet_.data.sw_version);
+        return true;
+    }
+
+    bool getVersionOfLidarHardware(std::string &version) const override
+    {
+        if (!has_version_)
+        {
+            return false;
+        }
+        version = formatVersion(version_packet_.data.hw_version);
+        return true;
+    }
+
+    bool getTimeDelay(double &delay) const override
+    {
+        delay = delay_;
+        return has_delay_;
+    }
+
+    /**
+     * @brief Dirty index reported by the last point packet
+     */
+    bool getDirtyPercentage(float &percentage) const override
+    {
+        percentage = dirty_;
+        return has_dirty_;
+    }
+
+    void sendUserCtrlCmd(LidarUserCtrlCmd cmd) override
+    {
+        LidarUserCtrlCmdPacket packet;
+        packet.data = cmd;
+        send(packet, LIDAR_USER_CMD_PACKET_TYPE);
+    }
+
+    void setLidarWorkMode(uint32_t mode) override
+    {
+        LidarWorkModeConfigPacket packet;
+        packet.data.mode = mode;
+        send(packet, LIDAR_WORK_MODE_CONFIG_PACKET_TYPE);
+    }
+
+    void syncLidarTimeStamp() override
+    {
+        LidarTimeStampPacket packet;
+        getSystemTimeStamp(packet.data);
+        send(packet, LIDAR_TIME_STAMP_PACKET_TYPE);
+    }
+
+    void resetLidar() override { sendUserCtrlCmd({USER_CMD_RESET_TYPE, 1}); }
+
+    void stopLidarRotation() override { sendUserCtrlCmd({USER_CMD_STANDBY_TYPE, 1}); }
+
+    void startLidarRotation() override { sendUserCtrlCmd({USER_CMD_STANDBY_TYPE, 0}); }
+
+    void setLidarIpAddressConfig(LidarIpAddressConfig config) override
+    {
+        LidarIpAddressConfigPacket packet;
+        packet.data = config;
+        send(packet, LIDAR_IP_ADDRESS_CONFIG_PACKET_TYPE);
+    }
+
+    void setLidarMacAddressConfig(LidarMacAddressConfig config) override
+    {
+        LidarMacAddressConfigPacket packet;
+        packet.data = config;
+        send(packet, LIDAR_MAC_ADDRESS_CONFIG_PACKET_TYPE);
+    }
+
+    /**
+     * @brief Bytes of the batch not parsed yet
+     */
+    size_t getBufferCachedSize() const override
+    {
+        size_t bytes = 0;
+        for (size_t i = cursor_; i < receiver_.count(); i++)
+        {
+            bytes += receiver_.size(i);
+        }
+        return bytes;
+    }
+
+    /**
+     * @brief Bytes of the last batch
+     */
+    size_t getBufferReadSize() const override
+    {
+        size_t bytes = 0;
+        for (size_t i = 0; i < receiver_.count(); i++)
+        {
+            bytes += receiver_.size(i);
+        }
+        return bytes;
+    }
+
+    /**
+     * @brief Receive time of the packet returned by the last runParse() [s], taken by the
+     *        kernel when kernel timestamps are on, CLOCK_REALTIME like getSystemTimeStamp()
+     */
+    double lastPacketStamp() const { return last_stamp_; }
+
+    const UdpBatchReceiver &receiver() const { return receiver_; }
+
+    /// Datagrams skipped because they were not one well formed packet
+    uint64_t malformed() const { return malformed_; }
+
+private:
+    template <typename Packet>
+    void send(Packet &packet, uint32_t packet_type)
+    {
+        framePacket(packet, packet_type);
+        receiver_.send(&packet, sizeof(Packet), lidar_ip_, lidar_port_);
+    }
+
+    template <typename Packet>
+    bool copyPacket(Packet &packet, const uint8_t *buf, size_t size)
+    {
+        if (size != sizeof(Packet))
+        {
+            malformed_++;
+            return false;
+        }
+        memcpy(&packet, buf, sizeof(Packet));
+        return true;
+    }
+
+    /**
+     * @brief Latency probe and version request, at most once a second
+     */
+    void probe()
+    {
+        const auto now = std::chrono::steady_clock::now();
+        if (now < next_probe_)
+        {
+            return;
+        }
+        next_probe_ = now + std::chrono::seconds(1);
+
+        LidarUserCtrlCmdPacket packet;
+        packet.data.cmd_type = CMD_LATENCY_TYPE;
+        packet.data.cmd_value = ++probe_seq_;
+        probe_sent_ = now;
+        send(packet, LIDAR_COMMAND_PACKET_TYPE);
+
+        if (!has_version_)
+        {
+            sendUserCtrlCmd({USER_CMD_VERSION_GET, 0});
+        }
+    }
+
+    int parsePacket(const uint8_t *buf, size_t size, double stamp)
+    {
+        const uint32_t packet_type = checkPacketFrame(buf, size);
+        switch (packet_type)
+        {
+        case LIDAR_POINT_DATA_PACKET_TYPE:
+            if (!copyPacket(point_packet_, buf, size))
+            {
+                return 0;
+            }
+            dirty_ = point_packet_.data.state.dirty_index;
+            has_dirty_ = true;
+            addScan(stamp);
+            break;
+        case LIDAR_2D_POINT_DATA_PACKET_TYPE:
+            if (!copyPacket(point_2d_packet_, buf, size))
+            {
+                return 0;
+            }
+            break;
+        case LIDAR_IMU_DATA_PACKET_TYPE:
+            if (!copyPacket(imu_packet_, buf, size))
+            {
+                return 0;
+            }
+            has_imu_ = true;
+            break;
+        case LIDAR_VERSION_PACKET_TYPE:
+            if (!copyPacket(version_packet_, buf, size))
+            {
+                return 0;
+            }
+            has_version_ = true;
+            break;
+        case LIDAR_ACK_DATA_PACKET_TYPE:
+            if (!copyPacket(ack_packet_, buf, size))
+            {
+                return 0;
+            }
+            if (ack_packet_.data.packet_type == LIDAR_COMMAND_PACKET_TYPE &&
+                ack_packet_.data.cmd_type == CMD_LATENCY_TYPE && ack_packet_.data.cmd_value == probe_seq_)
+            {
+                delay_ = std::chrono::duration<double>(std::chrono::steady_clock::now() - probe_sent_).count() / 2;
+                has_delay_ = true;
+            }
+            break;
+        case 0:
+            malformed_++;
+            return 0;
+        default:
+            // time stamps and parameters of the lidar are not used
+            return 0;
+        }
+        return (int)packet_type;
+    }
+
+    /**
+     * @brief Project the point packet just copied into the point cloud under construction
+     */
+    void addScan(double stamp)
+    {
+        const LidarPointData &data = point_packet_.data;
+        const double packet_stamp = use_system_timestamp_ ? stamp - data.scan_period
+                                                          : data.info.stamp.sec + data.info.stamp.nsec / 1.0e9;
+        if (building_packets_ == 0)
+        {
+            building_.stamp = packet_stamp;
+            building_.ringNum = 1;
+            building_.points.clear();
+        }
+
+        threadLocalProjector().project(packet_cloud_, data, range_min_, range_max_);
+        const float offset = (float)(packet_stamp - building_.stamp);
+        for (PointUnitree &point : packet_cloud_.points)
+        {
+            point.time += offset;
+            building_.points.push_back(point);
+        }
+
+        if (++building_packets_ >= cloud_scan_num_)
+        {
+            building_.id = ++cloud_count_;
+            std::swap(cloud_, building_);
+            building_packets_ = 0;
+            cloud_ready_ = true;
+        }
+    }
+
+    static std::string formatVersion(const uint8_t version[4])
+    {
+        return std::to_string(version[0]) + "." + std::to_string(version[1]) + "." +
+               std::to_string(version[2]) + "." + std::to_string(version[3]);
+    }
+
+    size_t batch_;
+    int receive_buffer_;
+    bool kernel_timestamps_;
+
+    UdpBatchReceiver receiver_;
+    size_t cursor_ = 0;     // next datagram of the batch to parse
+    double last_stamp_ = 0; // receive time of the last packet returned
+    uint64_t malformed_ = 0;
+
+    std::string lidar_ip_;
+    unsigned short lidar_port_ = 6101;
+    size_t cloud_scan_num_ = 18;
+    bool use_system_timestamp_ = true;
+    float range_min_ = 0;
+    float range_max_ = 100;
+
+    // last packets parsed
+    LidarPointDataPacket point_packet_;
+    Lidar2DPointDataPacket point_2d_packet_;
+    LidarImuDataPacket imu_packet_;
+    LidarVersionDataPacket version_packet_;
+    LidarAckDataPacket ack_packet_;
+    bool has_imu_ = false;
+    bool has_version_ = false;
+    float dirty_ = 0;
+    bool has_dirty_ = false;
+
+    // latency probe
+    std::chrono::steady_clock::time_point next_probe_;
+    std::chrono::steady_clock::time_point probe_sent_;
+    uint32_t probe_seq_ = 0;
+    double delay_ = 0;
+    bool has_delay_ = false;
+
+    // point cloud under construction and the last one completed
+    PointCloudUnitree packet_cloud_;
+    PointCloudUnitree building_;
+    size_t building_packets_ = 0;
+    PointCloudUnitree cloud_;
+    bool cloud_ready_ = false;
+    uint32_t cloud_count_ = 0; // point clouds completed since initializeUDP(), numbers them
+};
+
+} // end of namespace unilidar_sdk2
@@ -0,0 +1,274 @@
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+#include <array>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#define UNILIDAR_CRC32_PCLMUL 1
+#elif defined(__aarch64__) && defined(__linux__)
+#include <arm_acle.h>
+#include <sys/auxv.h>
+#define UNILIDAR_CRC32_ARMV8 1
+#ifndef HWCAP_CRC32
+#define HWCAP_CRC32 (1 << 7)
+#endif
+#endif
+
+namespace unilidar_sdk2{
+
+/**
+ * @brief CRC-32 (IEEE 802.3, reflected polynomial 0xEDB88320) implementations
+ * @note Every crc32Update* function takes and returns the raw register, i.e. the
+ *       caller applies the initial 0xFFFFFFFF and the final inversion. The
+ *       SSE4.2 crc32 instruction computes CRC-32C (Castagnoli) and cannot be used
+ *       here, x86 uses carry-less multiplication (PCLMULQDQ) folding instead.
+ */
+typedef uint32_t (*Crc32Update)(uint32_t crc, const uint8_t *buf, uint32_t len);
+
+/**
+ * @brief Bit-at-a-time reference
+ */
+inline uint32_t crc32UpdateBitwise(uint32_t crc, const uint8_t *buf, uint32_t len)
+{
+    while (len--)
+    {
+        crc ^= *buf++;
+        for (int i = 0; i < 8; ++i)
+        {
+            if (crc & 1)
+                crc = (crc >> 1) ^ 0xEDB88320;
+            else
+                crc = (crc >> 1);
+        }
+    }
+    return crc;
+}
+
+/**
+ * @brief Lookup tables of the slicing-by-8 algorithm
+ */
+struct Crc32Tables
+{
+    std::array<std::array<uint32_t, 256>, 8> table{};
+
+    constexpr Crc32Tables()
+    {
+        for (uint32_t i = 0; i < 256; i++)
+        {
+            uint32_t crc = i;
+            for (int k = 0; k < 8; k++)
+            {
+                crc = (crc & 1) ? (crc >> 1) ^ 0xEDB88320 : (crc >> 1);
+            }
+            table[0][i] = crc;
+        }
+        for (uint32_t i = 0; i < 256; i++)
+        {
+            for (int t = 1; t < 8; t++)
+            {
+                table[t][i] = (table[t - 1][i] >> 8) ^ table[0][table[t - 1][i] & 0xFF];
+            }
+        }
+    }
+};
+
+/**
+ * @brief Slicing-by-8, eight table lookups per 8 bytes
+ */
+inline uint32_t crc32UpdateSlice8(uint32_t crc, const uint8_t *buf, uint32_t len)
+{
+    static constexpr Crc32Tables tables;
+    const auto &t = tables.table;
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    while (len >= 8)
+    {
+        uint32_t one, two;
+        memcpy(&one, buf, 4);
+        memcpy(&two, buf + 4, 4);
+        one ^= crc;
+        crc = t[7][one & 0xFF] ^ t[6][(one >> 8) & 0xFF] ^ t[5][(one >> 16) & 0xFF] ^ t[4][one >> 24] ^
+              t[3][two & 0xFF] ^ t[2][(two >> 8) & 0xFF] ^ t[1][(two >> 16) & 0xFF] ^ t[0][two >> 24];
+        buf += 8;
+        len -= 8;
+    }
+#endif
+
+    while (len--)
+    {
+        crc = (crc >> 8) ^ t[0][(crc ^ *buf++) & 0xFF];
+    }
+    return crc;
+}
+
+#if defined(UNILIDAR_CRC32_PCLMUL)
+
+/**
+ * @brief PCLMULQDQ folding, four 128-bit lanes folded per 64 bytes
+ * @note Folding constants and Barrett reduction as in Intel's "Fast CRC
+ *       Computation for Generic Polynomials Using PCLMULQDQ Instruction".
+ */
+__attribute__((target("pclmul,sse4.1")))
+inline uint32_t crc32UpdatePclmul(uint32_t crc, const uint8_t *buf, uint32_t len)
+{
+    if (len < 64)
+    {
+        return crc32UpdateSlice8(crc, buf, len);
+    }
+
+    alignas(16) static const uint64_t k1k2[] = {0x0154442bd4, 0x01c6e41596};
+    alignas(16) static const uint64_t k3k4[] = {0x01751997d0, 0x00ccaa009e};
+    alignas(16) static const uint64_t k5k0[] = {0x0163cd6124, 0x0000000000};
+    alignas(16) static const uint64_t poly[] = {0x01db710641, 0x01f7011641};
+
+    const uint32_t tail = len & 15;
+    const uint8_t *end = buf + (len - tail);
+
+    __m128i x0, x1, x2, x3, x4, x5, x6, x7, x8, y5, y6, y7, y8;
+
+    x1 = _mm_loadu_si128((const __m128i *)(buf + 0x00));
+    x2 = _mm_loadu_si128((const __m128i *)(buf + 0x10));
+    x3 = _mm_loadu_si128((const __m128i *)(buf + 0x20));
+    x4 = _mm_loadu_si128((const __m128i *)(buf + 0x30));
+    x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128(crc));
+    x0 = _mm_load_si128((const __m128i *)k1k2);
+    buf += 64;
+
+    // fold 4 x 128 bits in parallel
+    while (end - buf >= 64)
+    {
+        x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+        x6 = _mm_clmulepi64_si128(x2, x0, 0x00);
+        x7 = _mm_clmulepi64_si128(x3, x0, 0x00);
+        x8 = _mm_clmulepi64_si128(x4, x0, 0x00);
+
+        x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+        x2 = _mm_clmulepi64_si128(x2, x0, 0x11);
+        x3 = _mm_clmulepi64_si128(x3, x0, 0x11);
+        x4 = _mm_clmulepi64_si128(x4, x0, 0x11);
+
+        y5 = _mm_loadu_si128((const __m128i *)(buf + 0x00));
+        y6 = _mm_loadu_si128((const __m128i *)(buf + 0x10));
+        y7 = _mm_loadu_si128((const __m128i *)(buf + 0x20));
+        y8 = _mm_loadu_si128((const __m128i *)(buf + 0x30));
+
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, x5), y5);
+        x2 = _mm_xor_si128(_mm_xor_si128(x2, x6), y6);
+        x3 = _mm_xor_si128(_mm_xor_si128(x3, x7), y7);
+        x4 = _mm_xor_si128(_mm_xor_si128(x4, x8), y8);
+
+        buf += 64;
+    }
+
+    // fold the 4 lanes into one
+    x0 = _mm_load_si128((const __m128i *)k3k4);
+
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x3), x5);
+
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x4), x5);
+
+    // fold the remaining 16 byte blocks
+    while (end - buf >= 16)
+    {
+        x2 = _mm_loadu_si128((const __m128i *)buf);
+
+        x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+        x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+
+        buf += 16;
+    }
+
+    // fold 128 bits to 64 bits
+    x2 = _mm_clmulepi64_si128(x1, x0, 0x10);
+    x3 = _mm_setr_epi32(~0, 0, ~0, 0);
+    x1 = _mm_srli_si128(x1, 8);
+    x1 = _mm_xor_si128(x1, x2);
+
+    x0 = _mm_loadl_epi64((const __m128i *)k5k0);
+
+    x2 = _mm_srli_si128(x1, 4);
+    x1 = _mm_and_si128(x1, x3);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_xor_si128(x1, x2);
+
+    // Barrett reduction to 32 bits
+    x0 = _mm_load_si128((const __m128i *)poly);
+
+    x2 = _mm_and_si128(x1, x3);
+    x2 = _mm_clmulepi64_si128(x2, x0, 0x10);
+    x2 = _mm_and_si128(x2, x3);
+    x2 = _mm_clmulepi64_si128(x2, x0, 0x00);
+    x1 = _mm_xor_si128(x1, x2);
+
+    crc = (uint32_t)_mm_extract_epi32(x1, 1);
+    return crc32UpdateSlice8(crc, buf, tail);
+}
+
+#endif // UNILIDAR_CRC32_PCLMUL
+
+#if defined(UNILIDAR_CRC32_ARMV8)
+
+/**
+ * @brief ARMv8 CRC32 instructions, 8 bytes per instruction
+ */
+__attribute__((target("+crc")))
+inline uint32_t crc32UpdateArmv8(uint32_t crc, const uint8_t *buf, uint32_t len)
+{
+    while (len >= 8)
+    {
+        uint64_t v;
+        memcpy(&v, buf, 8);
+        crc = __crc32d(crc, v);
+        buf += 8;
+        len -= 8;
+    }
+    while (len--)
+    {
+        crc = __crc32b(crc, *buf++);
+    }
+    return crc;
+}
+
+#endif // UNILIDAR_CRC32_ARMV8
+
+/**
+ * @brief Pick the fastest implementation supported by the running CPU
+ */
+inline Crc32Update selectCrc32Update()
+{
+#if defined(UNILIDAR_CRC32_PCLMUL)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("pclmul") && __builtin_cpu_supports("sse4.1"))
+    {
+        return crc32UpdatePclmul;
+    }
+#elif defined(UNILIDAR_CRC32_ARMV8)
+    if (getauxval(AT_HWCAP) & HWCAP_CRC32)
+    {
+        return crc32UpdateArmv8;
+    }
+#endif
+    return crc32UpdateSlice8;
+}
+
+/**
+ * @brief The implementation selected for this process
+ */
+inline Crc32Update crc32Update()
+{
+    static const Crc32Update update = selectCrc32Update();
+    return update;
+}
+
+} // end of namespace unilidar_sdk2
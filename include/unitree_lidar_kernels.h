@@ -0,0 +1,423 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <array>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#define UNILIDAR_KERNELS_X86 1
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#define UNILIDAR_KERNELS_NEON 1
+#endif
+
+// the kernels must agree bit by bit, so never fuse their multiply-adds
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC push_options
+#pragma GCC optimize("fp-contract=off")
+#elif defined(__clang__)
+#pragma clang fp contract(off)
+#endif
+
+namespace unilidar_sdk2{
+
+/**
+ * @brief Inputs of the packet-to-XYZ kernels, all tables are indexed by beam
+ */
+typedef struct
+{
+    const uint16_t *ranges;       // raw ranges [mm]
+    const uint8_t *intensities;   // raw intensities
+    const float *coef_a;          // A = coef_a * range + b_axis_dist
+    const float *coef_b;          // B = coef_b * range
+    const float *coef_c;          // z = coef_c * range + a_axis_dist
+    const float *sin_theta;       // horizontal angle of every beam
+    const float *cos_theta;
+    int num;                      // number of beams
+    float range_scale;
+    float range_bias;
+    float range_lo;               // points outside [range_lo, range_hi] are dropped
+    float range_hi;
+    float a_axis_dist;
+    float b_axis_dist;
+    float time_step;
+} ProjectionKernelInput;
+
+/**
+ * @brief Column outputs of the packet-to-XYZ kernels
+ * @note Every column needs room for num + PROJECTION_KERNEL_SLACK floats, the
+ *       vector kernels store whole registers past the last kept point.
+ */
+typedef struct
+{
+    float *x;
+    float *y;
+    float *z;
+    float *intensity;
+    float *time;
+} ProjectionKernelOutput;
+
+const int PROJECTION_KERNEL_SLACK = 8;
+
+/**
+ * @brief Convert the valid beams of a packet to points, returns the number kept
+ * @note All kernels evaluate the same float operations in the same order (no fused
+ *       multiply-add), so their outputs are bit-identical to projectPointsScalar.
+ */
+typedef int (*ProjectionKernel)(const ProjectionKernelInput &in, const ProjectionKernelOutput &out);
+
+/**
+ * @brief Reference kernel, also used for the tail of the vector kernels
+ */
+inline int projectPointsScalarRange(const ProjectionKernelInput &in, const ProjectionKernelOutput &out,
+                                    int begin, int count)
+{
+    for (int j = begin; j < in.num; j++)
+    {
+        const float raw = (float)in.ranges[j];
+        const float range = in.range_scale * (raw + in.range_bias);
+        if (!(raw >= 1.0f && range >= in.range_lo && range <= in.range_hi))
+        {
+            continue;
+        }
+
+        const float A = in.coef_a[j] * range + in.b_axis_dist;
+        const float B = in.coef_b[j] * range;
+
+        out.x[count] = in.cos_theta[j] * A - in.sin_theta[j] * B;
+        out.y[count] = in.sin_theta[j] * A + in.cos_theta[j] * B;
+        out.z[count] = in.coef_c[j] * range + in.a_axis_dist;
+        out.intensity[count] = (float)in.intensities[j];
+        out.time[count] = (float)j * in.time_step;
+        count++;
+    }
+    return count;
+}
+
+inline int projectPointsScalar(const ProjectionKernelInput &in, const ProjectionKernelOutput &out)
+{
+    return projectPointsScalarRange(in, out, 0, 0);
+}
+
+#if defined(UNILIDAR_KERNELS_X86)
+
+/**
+ * @brief SSE2 kernel, 8 beams per iteration as two 4-lane halves
+ */
+inline int projectPointsSse2(const ProjectionKernelInput &in, const ProjectionKernelOutput &out)
+{
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 scale = _mm_set1_ps(in.range_scale);
+    const __m128 bias = _mm_set1_ps(in.range_bias);
+    const __m128 lo = _mm_set1_ps(in.range_lo);
+    const __m128 hi = _mm_set1_ps(in.range_hi);
+    const __m128 a_axis = _mm_set1_ps(in.a_axis_dist);
+    const __m128 b_axis = _mm_set1_ps(in.b_axis_dist);
+    const __m128 t_step = _mm_set1_ps(in.time_step);
+    const __m128i lane = _mm_setr_epi32(0, 1, 2, 3);
+    const __m128i zero = _mm_setzero_si128();
+
+    alignas(16) float tx[4], ty[4], tz[4], ti[4], tt[4];
+
+    int count = 0;
+    int j = 0;
+    for (; j + 8 <= in.num; j += 8)
+    {
+        const __m128i r16 = _mm_loadu_si128((const __m128i *)(in.ranges + j));
+        const __m128i i16 = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)(in.intensities + j)), zero);
+        const __m128i r32[2] = {_mm_unpacklo_epi16(r16, zero), _mm_unpackhi_epi16(r16, zero)};
+        const __m128i i32[2] = {_mm_unpacklo_epi16(i16, zero), _mm_unpackhi_epi16(i16, zero)};
+
+        for (int h = 0; h < 2; h++)
+        {
+            const int k = j + 4 * h;
+            const __m128 raw = _mm_cvtepi32_ps(r32[h]);
+            const __m128 range = _mm_mul_ps(scale, _mm_add_ps(raw, bias));
+            const __m128 valid = _mm_and_ps(_mm_cmpge_ps(raw, one),
+                                            _mm_and_ps(_mm_cmpge_ps(range, lo), _mm_cmple_ps(range, hi)));
+            int mask = _mm_movemask_ps(valid);
+            if (mask == 0)
+            {
+                continue;
+            }
+
+            const __m128 st = _mm_loadu_ps(in.sin_theta + k);
+            const __m128 ct = _mm_loadu_ps(in.cos_theta + k);
+            const __m128 A = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(in.coef_a + k), range), b_axis);
+            const __m128 B = _mm_mul_ps(_mm_loadu_ps(in.coef_b + k), range);
+
+            _mm_store_ps(tx, _mm_sub_ps(_mm_mul_ps(ct, A), _mm_mul_ps(st, B)));
+            _mm_store_ps(ty, _mm_add_ps(_mm_mul_ps(st, A), _mm_mul_ps(ct, B)));
+            _mm_store_ps(tz, _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(in.coef_c + k), range), a_axis));
+            _mm_store_ps(ti, _mm_cvtepi32_ps(i32[h]));
+            _mm_store_ps(tt, _mm_mul_ps(_mm_cvtepi32_ps(_mm_add_epi32(_mm_set1_epi32(k), lane)), t_step));
+
+            // compress the kept lanes
+            while (mask)
+            {
+                const int l = __builtin_ctz(mask);
+                out.x[count] = tx[l];
+                out.y[count] = ty[l];
+                out.z[count] = tz[l];
+                out.intensity[count] = ti[l];
+                out.time[count] = tt[l];
+                count++;
+                mask &= mask - 1;
+            }
+        }
+    }
+    return projectPointsScalarRange(in, out, j, count);
+}
+
+/**
+ * @brief Lane permutations that move the set lanes of an 8-bit mask to the front
+ */
+struct CompressTableAvx2
+{
+    std::array<std::array<uint32_t, 8>, 256> perm{};
+
+    constexpr CompressTableAvx2()
+    {
+        for (int mask = 0; mask < 256; mask++)
+        {
+            int n = 0;
+            for (int l = 0; l < 8; l++)
+            {
+                if (mask & (1 << l))
+                {
+                    perm[mask][n++] = l;
+                }
+            }
+        }
+    }
+};
+
+/**
+ * @brief AVX2 kernel, 8 beams per iteration, kept lanes compressed with a permute
+ */
+__attribute__((target("avx2,popcnt")))
+inline int projectPointsAvx2(const ProjectionKernelInput &in, const ProjectionKernelOutput &out)
+{
+    static constexpr CompressTableAvx2 table;
+
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const __m256 scale = _mm256_set1_ps(in.range_scale);
+    const __m256 bias = _mm256_set1_ps(in.range_bias);
+    const __m256 lo = _mm256_set1_ps(in.range_lo);
+    const __m256 hi = _mm256_set1_ps(in.range_hi);
+    const __m256 a_axis = _mm256_set1_ps(in.a_axis_dist);
+    const __m256 b_axis = _mm256_set1_ps(in.b_axis_dist);
+    const __m256 t_step = _mm256_set1_ps(in.time_step);
+    const __m256i lane = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+
+    int count = 0;
+    int j = 0;
+    for (; j + 8 <= in.num; j += 8)
+    {
+        const __m256 raw = _mm256_cvtepi32_ps(_mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i *)(in.ranges + j))));
+        const __m256 range = _mm256_mul_ps(scale, _mm256_add_ps(raw, bias));
+        const __m256 valid = _mm256_and_ps(_mm256_cmp_ps(raw, one, _CMP_GE_OQ),
+                                           _mm256_and_ps(_mm256_cmp_ps(range, lo, _CMP_GE_OQ),
+                                                         _mm256_cmp_ps(range, hi, _CMP_LE_OQ)));
+        const int mask = _mm256_movemask_ps(valid);
+        if (mask == 0)
+        {
+            continue;
+        }
+
+        const __m256 st = _mm256_loadu_ps(in.sin_theta + j);
+        const __m256 ct = _mm256_loadu_ps(in.cos_theta + j);
+        const __m256 A = _mm256_add_ps(_mm256_mul_ps(_mm256_loadu_ps(in.coef_a + j), range), b_axis);
+        const __m256 B = _mm256_mul_ps(_mm256_loadu_ps(in.coef_b + j), range);
+
+        const __m256 x = _mm256_sub_ps(_mm256_mul_ps(ct, A), _mm256_mul_ps(st, B));
+        const __m256 y = _mm256_add_ps(_mm256_mul_ps(st, A), _mm256_mul_ps(ct, B));
+        const __m256 z = _mm256_add_ps(_mm256_mul_ps(_mm256_loadu_ps(in.coef_c + j), range), a_axis);
+        const __m256 intensity = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)(in.intensities + j))));
+        const __m256 time = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_add_epi32(_mm256_set1_epi32(j), lane)), t_step);
+
+        // compress the kept lanes to the front, the remaining lanes are overwritten next time
+        const __m256i perm = _mm256_loadu_si256((const __m256i *)table.perm[mask].data());
+        _mm256_storeu_ps(out.x + count, _mm256_permutevar8x32_ps(x, perm));
+        _mm256_storeu_ps(out.y + count, _mm256_permutevar8x32_ps(y, perm));
+        _mm256_storeu_ps(out.z + count, _mm256_permutevar8x32_ps(z, perm));
+        _mm256_storeu_ps(out.intensity + count, _mm256_permutevar8x32_ps(intensity, perm));
+        _mm256_storeu_ps(out.time + count, _mm256_permutevar8x32_ps(time, perm));
+        count += _mm_popcnt_u32(mask);
+    }
+    return projectPointsScalarRange(in, out, j, count);
+}
+
+#endif // UNILIDAR_KERNELS_X86
+
+#if defined(UNILIDAR_KERNELS_NEON)
+
+/**
+ * @brief NEON kernel, 8 beams per iteration as two 4-lane halves
+ */
+inline int projectPointsNeon(const ProjectionKernelInput &in, const ProjectionKernelOutput &out)
+{
+    const float32x4_t one = vdupq_n_f32(1.0f);
+    const float32x4_t scale = vdupq_n_f32(in.range_scale);
+    const float32x4_t bias = vdupq_n_f32(in.range_bias);
+    const float32x4_t lo = vdupq_n_f32(in.range_lo);
+    const float32x4_t hi = vdupq_n_f32(in.range_hi);
+    const float32x4_t a_axis = vdupq_n_f32(in.a_axis_dist);
+    const float32x4_t b_axis = vdupq_n_f32(in.b_axis_dist);
+    const float32x4_t t_step = vdupq_n_f32(in.time_step);
+    const uint32_t lane_init[4] = {0, 1, 2, 3};
+    const uint32x4_t lane = vld1q_u32(lane_init);
+
+    float tx[4], ty[4], tz[4], ti[4], tt[4];
+    uint32_t tv[4];
+
+    int count = 0;
+    int j = 0;
+    for (; j + 8 <= in.num; j += 8)
+    {
+        const uint16x8_t r16 = vld1q_u16(in.ranges + j);
+        const uint16x8_t i16 = vmovl_u8(vld1_u8(in.intensities + j));
+        const uint32x4_t r32[2] = {vmovl_u16(vget_low_u16(r16)), vmovl_u16(vget_high_u16(r16))};
+        const uint32x4_t i32[2] = {vmovl_u16(vget_low_u16(i16)), vmovl_u16(vget_high_u16(i16))};
+
+        for (int h = 0; h < 2; h++)
+        {
+            const int k = j + 4 * h;
+            const float32x4_t raw = vcvtq_f32_u32(r32[h]);
+            const float32x4_t range = vmulq_f32(scale, vaddq_f32(raw, bias));
+            const uint32x4_t valid = vandq_u32(vcgeq_f32(raw, one),
+                                               vandq_u32(vcgeq_f32(range, lo), vcleq_f32(range, hi)));
+            if (vmaxvq_u32(valid) == 0)
+            {
+                continue;
+            }
+
+            const float32x4_t st = vld1q_f32(in.sin_theta + k);
+            const float32x4_t ct = vld1q_f32(in.cos_theta + k);
+            const float32x4_t A = vaddq_f32(vmulq_f32(vld1q_f32(in.coef_a + k), range), b_axis);
+            const float32x4_t B = vmulq_f32(vld1q_f32(in.coef_b + k), range);
+
+            vst1q_f32(tx, vsubq_f32(vmulq_f32(ct, A), vmulq_f32(st, B)));
+            vst1q_f32(ty, vaddq_f32(vmulq_f32(st, A), vmulq_f32(ct, B)));
+            vst1q_f32(tz, vaddq_f32(vmulq_f32(vld1q_f32(in.coef_c + k), range), a_axis));
+            vst1q_f32(ti, vcvtq_f32_u32(i32[h]));
+            vst1q_f32(tt, vmulq_f32(vcvtq_f32_u32(vaddq_u32(vdupq_n_u32(k), lane)), t_step));
+            vst1q_u32(tv, valid);
+
+            // compress the kept lanes
+            for (int l = 0; l < 4; l++)
+            {
+                if (tv[l] == 0)
+                {
+                    continue;
+                }
+                out.x[count] = tx[l];
+                out.y[count] = ty[l];
+                out.z[count] = tz[l];
+                out.intensity[count] = ti[l];
+                out.time[count] = tt[l];
+                count++;
+            }
+        }
+    }
+    return projectPointsScalarRange(in, out, j, count);
+}
+
+#endif // UNILIDAR_KERNELS_NEON
+
+/**
+ * @brief Pick the widest kernel supported by the running CPU
+ */
+inline ProjectionKernel selectProjectionKernel()
+{
+#if defined(UNILIDAR_KERNELS_X86)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+    {
+        return projectPointsAvx2;
+    }
+    return projectPointsSse2;
+#elif defined(UNILIDAR_KERNELS_NEON)
+    return projectPointsNeon;
+#else
+    return projectPointsScalar;
+#endif
+}
+
+/**
+ * @brief The kernel selected for this process
+ * @note It only serves PointCloudProjector, i.e. the native pipeline, the replay reader
+ *       and the batched UDP reader. The reader of createUnitreeLidarReader() converts its
+ *       packets with the code built into libunilidar_sdk2.a.
+ */
+inline ProjectionKernel projectionKernel()
+{
+    static const ProjectionKernel kernel = selectProjectionKernel();
+    return kernel;
+}
+
+/**
+ * @brief Apply the rigid transform [R | t] (row-major 3x4) to n points stored as columns, in place
+ * @note SSE2 / NEON for whole registers and the scalar loop for the tail, both evaluate
+ *       ((m0 x + m1 y) + m2 z) + m3 so every point gets the same bits whichever path runs.
+ */
+inline void transformPoints(const float matrix[12], float *x, float *y, float *z, size_t n)
+{
+    size_t i = 0;
+
+#if defined(UNILIDAR_KERNELS_X86)
+    __m128 m[12];
+    for (int k = 0; k < 12; k++)
+    {
+        m[k] = _mm_set1_ps(matrix[k]);
+    }
+    for (; i + 4 <= n; i += 4)
+    {
+        const __m128 px = _mm_loadu_ps(x + i);
+        const __m128 py = _mm_loadu_ps(y + i);
+        const __m128 pz = _mm_loadu_ps(z + i);
+        _mm_storeu_ps(x + i, _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(m[0], px), _mm_mul_ps(m[1], py)),
+                                                   _mm_mul_ps(m[2], pz)), m[3]));
+        _mm_storeu_ps(y + i, _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(m[4], px), _mm_mul_ps(m[5], py)),
+                                                   _mm_mul_ps(m[6], pz)), m[7]));
+        _mm_storeu_ps(z + i, _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(m[8], px), _mm_mul_ps(m[9], py)),
+                                                   _mm_mul_ps(m[10], pz)), m[11]));
+    }
+#elif defined(UNILIDAR_KERNELS_NEON)
+    float32x4_t m[12];
+    for (int k = 0; k < 12; k++)
+    {
+        m[k] = vdupq_n_f32(matrix[k]);
+    }
+    for (; i + 4 <= n; i += 4)
+    {
+        const float32x4_t px = vld1q_f32(x + i);
+        const float32x4_t py = vld1q_f32(y + i);
+        const float32x4_t pz = vld1q_f32(z + i);
+        vst1q_f32(x + i, vaddq_f32(vaddq_f32(vaddq_f32(vmulq_f32(m[0], px), vmulq_f32(m[1], py)),
+                                             vmulq_f32(m[2], pz)), m[3]));
+        vst1q_f32(y + i, vaddq_f32(vaddq_f32(vaddq_f32(vmulq_f32(m[4], px), vmulq_f32(m[5], py)),
+                                             vmulq_f32(m[6], pz)), m[7]));
+        vst1q_f32(z + i, vaddq_f32(vaddq_f32(vaddq_f32(vmulq_f32(m[8], px), vmulq_f32(m[9], py)),
+                                             vmulq_f32(m[10], pz)), m[11]));
+    }
+#endif
+
+    for (; i < n; i++)
+    {
+        const float px = x[i], py = y[i], pz = z[i];
+        x[i] = matrix[0] * px + matrix[1] * py + matrix[2] * pz + matrix[3];
+        y[i] = matrix[4] * px + matrix[5] * py + matrix[6] * pz + matrix[7];
+        z[i] = matrix[8] * px + matrix[9] * py + matrix[10] * pz + matrix[11];
+    }
+}
+
+} // end of namespace unilidar_sdk2
+
+// restore contraction for the includers, clang has no push for it and goes back to its default (on)
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC pop_options
+#elif defined(__clang__)
+#pragma clang fp contract(on)
+#endif
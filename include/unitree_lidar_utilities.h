@@ -25,11 +25,15 @@ typedef unsigned __int64 uint64_t;
 #include <deque>
 #include <vector>
 #include <memory>
+#include <new>
+#include <algorithm>
 #include <math.h>
 #include <iostream>
 
 #include "unitree_lidar_sdk_config.h"
 #include "unitree_lidar_protocol.h"
+#include "unitree_lidar_kernels.h"
+#include "unitree_lidar_crc32.h"
 
 namespace unilidar_sdk2{
 
@@ -67,6 +71,143 @@ typedef struct
     std::vector<PointUnitree> points;
 } PointCloudUnitree;
 
+/**
+ * @brief Allocator aligning column buffers for vector loads and stores
+ */
+template <typename T, size_t Alignment = 64>
+struct AlignedAllocator
+{
+    typedef T value_type;
+
+    template <typename U>
+    struct rebind
+    {
+        typedef AlignedAllocator<U, Alignment> other;
+    };
+
+    AlignedAllocator() noexcept {}
+
+    template <typename U>
+    AlignedAllocator(const AlignedAllocator<U, Alignment> &) noexcept {}
+
+    T *allocate(size_t n)
+    {
+        return static_cast<T *>(::operator new(n * sizeof(T), std::align_val_t(Alignment)));
+    }
+
+    void deallocate(T *p, size_t) noexcept
+    {
+        ::operator delete(p, std::align_val_t(Alignment));
+    }
+
+    template <typename U>
+    bool operator==(const AlignedAllocator<U, Alignment> &) const noexcept { return true; }
+
+    template <typename U>
+    bool operator!=(const AlignedAllocator<U, Alignment> &) const noexcept { return false; }
+};
+
+template <typename T>
+using AlignedVector = std::vector<T, AlignedAllocator<T>>;
+
+/**
+ * @brief Point Cloud Type with one contiguous column per point field
+ * @note Same content as PointCloudUnitree, laid out for consumers that want
+ *       separate x/y/z columns (numpy, open3d, grid computations).
+ */
+struct PointCloudSoA
+{
+    double stamp = 0;     // cloud start timestamp, the point timestamp is relative to this
+    uint32_t id = 0;      // sequence id
+    uint32_t ringNum = 0; // number of rings
+    AlignedVector<float> x;
+    AlignedVector<float> y;
+    AlignedVector<float> z;
+    AlignedVector<float> intensity;
+    AlignedVector<float> time; // relative time of this point from cloud stamp
+    AlignedVector<uint32_t> ring;
+
+    size_t size() const { return x.size(); }
+
+    void clear()
+    {
+        x.clear();
+        y.clear();
+        z.clear();
+        intensity.clear();
+        time.clear();
+        ring.clear();
+    }
+
+    void reserve(size_t n)
+    {
+        x.reserve(n);
+        y.reserve(n);
+        z.reserve(n);
+        intensity.reserve(n);
+        time.reserve(n);
+        ring.reserve(n);
+    }
+
+    void resize(size_t n)
+    {
+        x.resize(n);
+        y.resize(n);
+        z.resize(n);
+        intensity.resize(n);
+        time.resize(n);
+        ring.resize(n, 1);
+    }
+
+    /**
+     * @brief Append the points of an array-of-structs cloud
+     * @note Point times stay relative to their own cloud stamp.
+     */
+    void append(const PointCloudUnitree &cloud)
+    {
+        if (size() == 0)
+        {
+            stamp = cloud.stamp;
+            id = cloud.id;
+            ringNum = cloud.ringNum;
+        }
+
+        const size_t offset = size();
+        resize(offset + cloud.points.size());
+        for (size_t k = 0; k < cloud.points.size(); k++)
+        {
+            const PointUnitree &point = cloud.points[k];
+            x[offset + k] = point.x;
+            y[offset + k] = point.y;
+            z[offset + k] = point.z;
+            intensity[offset + k] = point.intensity;
+            time[offset + k] = point.time;
+            ring[offset + k] = point.ring;
+        }
+    }
+
+    /**
+     * @brief Append the points of another column cloud
+     * @note Point times stay relative to their own cloud stamp.
+     */
+    void append(const PointCloudSoA &cloud)
+    {
+        if (size() == 0)
+        {
+            stamp = cloud.stamp;
+            id = cloud.id;
+            ringNum = cloud.ringNum;
+        }
+
+        x.insert(x.end(), cloud.x.begin(), cloud.x.end());
+        y.insert(y.end(), cloud.y.begin(), cloud.y.end());
+        z.insert(z.end(), cloud.z.begin(), cloud.z.end());
+        intensity.insert(intensity.end(), cloud.intensity.begin(), cloud.intensity.end());
+        time.insert(time.end(), cloud.time.begin(), cloud.time.end());
+        ring.insert(ring.end(), cloud.ring.begin(), cloud.ring.end());
+    }
+};
+
 ///////////////////////////////////////////////////////////////////////////////
 // FUNCTIONS
 ///////////////////////////////////////////////////////////////////////////////
@@ -97,23 +238,258 @@ inline double getSystemTimeStamp()
  * @param buf
  * @param len
  * @return uint32_t
+ * @note Dispatched at runtime to PCLMULQDQ (x86_64), the ARMv8 CRC32 instructions
+ *       (aarch64) or slicing-by-8 tables, see unitree_lidar_crc32.h.
+ * @note Only code compiled against this header uses it: checkPacketFrame() in the
+ *       batched UDP reader (udp_batch_receiver.h) and framePacket() for the commands it
+ *       sends and the packets of the emulator. The reader of createUnitreeLidarReader()
+ *       validates its frames with the crc built into libunilidar_sdk2.a.
  */
 inline uint32_t crc32(const uint8_t *buf, uint32_t len)
 {
-    uint8_t i;
-    uint32_t crc = 0xFFFFFFFF;
-    while (len--)
+    return ~crc32Update()(0xFFFFFFFF, buf, len);
+}
+
+/**
+ * @brief Fill the frame header and tail of a packet whose data is set
+ * @param[in,out] packet any FrameHeader, data, FrameTail packet of the protocol
+ * @param[in] packet_type LIDAR_*_PACKET_TYPE
+ * @note The crc covers the data only, like the packets the SDK sends.
+ */
+template <typename Packet>
+inline void framePacket(Packet &packet, uint32_t packet_type)
+{
+    packet.header.header[0] = FRAME_HEADER_ARRAY_0;
+    packet.header.header[1] = FRAME_HEADER_ARRAY_1;
+    packet.header.header[2] = FRAME_HEADER_ARRAY_2;
+    packet.header.header[3] = FRAME_HEADER_ARRAY_3;
+    packet.header.packet_type = packet_type;
+    packet.header.packet_size = sizeof(Packet);
+
+    packet.tail.crc32 = crc32((const uint8_t *)&packet.data, sizeof(packet.data));
+    packet.tail.msg_type_check = 0;
+    packet.tail.reserve[0] = 0;
+    packet.tail.reserve[1] = 0;
+    packet.tail.tail[0] = FRAME_TAIL_ARRAY_0;
+    packet.tail.tail[1] = FRAME_TAIL_ARRAY_1;
+}
+
+/**
+ * @brief Check the framing of a whole datagram: header, size, tail and crc of the data
+ * @return the packet type, or 0 if the datagram is not one well formed packet
+ */
+inline uint32_t checkPacketFrame(const uint8_t *buf, size_t size)
+{
+    if (size < sizeof(FrameHeader) + sizeof(FrameTail))
     {
-        crc ^= *buf++;
-        for (i = 0; i < 8; ++i)
+        return 0;
+    }
+
+    const FrameHeader *header = (const FrameHeader *)buf;
+    const FrameTail *tail = (const FrameTail *)(buf + size - sizeof(FrameTail));
+    if (header->header[0] != FRAME_HEADER_ARRAY_0 || header->header[1] != FRAME_HEADER_ARRAY_1 ||
+        header->header[2] != FRAME_HEADER_ARRAY_2 || header->header[3] != FRAME_HEADER_ARRAY_3 ||
+        tail->tail[0] != FRAME_TAIL_ARRAY_0 || tail->tail[1] != FRAME_TAIL_ARRAY_1 ||
+        header->packet_size != size)
+    {
+        return 0;
+    }
+
+    const uint32_t data_size = (uint32_t)(size - sizeof(FrameHeader) - sizeof(FrameTail));
+    if (tail->crc32 != crc32(buf + sizeof(FrameHeader), data_size))
+    {
+        return 0;
+    }
+    return header->packet_type;
+}
+
+/**
+ * @brief Cached projection from raw point packets to 3D points
+ * @note The beam angles and the calibration barely change between packets, so the
+ *       per-beam trigonometry is tabulated once and only rebuilt when they change.
+ *       The horizontal angle is advanced with the angle-addition recurrence, which
+ *       leaves a few multiply-adds per point, evaluated by the vectorized kernel
+ *       picked for this CPU (see unitree_lidar_kernels.h).
+ * @note Only code compiled against this header projects with it: the native pipeline
+ *       (point_cloud_pipeline.h, whichever reader feeds it), the replay reader
+ *       (lidar_capture.h) and the batched UDP reader (udp_batch_receiver.h). The clouds of
+ *       the reader of createUnitreeLidarReader() are projected by libunilidar_sdk2.a, so
+ *       its point cloud batch getters never run this code.
+ */
+class PointCloudProjector
+{
+public:
+    static constexpr int MAX_POINT_NUM = 300;
+
+    /**
+     * @brief Rebuild the per-beam tables if the calibration of this packet differs
+     * @return true if the tables were rebuilt
+     */
+    bool update(const LidarPointData &data)
+    {
+        if (valid_ &&
+            memcmp(&param_, &data.param, sizeof(LidarCalibParam)) == 0 &&
+            angle_min_ == data.angle_min &&
+            angle_increment_ == data.angle_increment &&
+            theta_step_ == data.com_horizontal_angle_step)
+        {
+            return false;
+        }
+
+        param_ = data.param;
+        angle_min_ = data.angle_min;
+        angle_increment_ = data.angle_increment;
+        theta_step_ = data.com_horizontal_angle_step;
+
+        const double sin_beta = sin(param_.beta_angle);
+        const double cos_beta = cos(param_.beta_angle);
+        const double sin_xi = sin(param_.xi_angle);
+        const double cos_xi = cos(param_.xi_angle);
+
+        for (int j = 0; j < MAX_POINT_NUM; j++)
+        {
+            const double alpha = (double)angle_min_ + param_.alpha_angle_bias + (double)j * angle_increment_;
+            const double sin_alpha = sin(alpha);
+            const double cos_alpha = cos(alpha);
+
+            coef_a_[j] = (float)(-cos_beta * sin_xi + sin_beta * cos_xi * sin_alpha);
+            coef_b_[j] = (float)(cos_alpha * cos_xi);
+            coef_c_[j] = (float)(sin_beta * sin_xi + cos_beta * cos_xi * sin_alpha);
+        }
+
+        sin_theta_step_ = sin((double)theta_step_);
+        cos_theta_step_ = cos((double)theta_step_);
+        valid_ = true;
+        return true;
+    }
+
+    /**
+     * @brief Project the points of a packet into columns
+     * @param[out] out columns with room for MAX_POINT_NUM + PROJECTION_KERNEL_SLACK floats
+     * @param[in] range_min allowed minimum point range in meters
+     * @param[in] range_max allowed maximum point range in meters
+     * @param[in] kernel kernel evaluating the points, the one picked for this CPU by default
+     * @return number of points written
+     */
+    int project(const ProjectionKernelOutput &out, const LidarPointData &data, float range_min, float range_max,
+                ProjectionKernel kernel = projectionKernel())
+    {
+        update(data);
+
+        ProjectionKernelInput in;
+        in.ranges = data.ranges;
+        in.intensities = data.intensities;
+        in.coef_a = coef_a_;
+        in.coef_b = coef_b_;
+        in.coef_c = coef_c_;
+        in.sin_theta = sin_theta_;
+        in.cos_theta = cos_theta_;
+        in.num = std::min<int>(data.point_num, MAX_POINT_NUM);
+        in.range_scale = data.param.range_scale;
+        in.range_bias = data.param.range_bias;
+        // both range limits collapse to a single interval
+        in.range_lo = std::max(data.range_min, range_min);
+        in.range_hi = std::min(data.range_max, range_max);
+        in.a_axis_dist = data.param.a_axis_dist;
+        in.b_axis_dist = data.param.b_axis_dist;
+        in.time_step = data.time_increment;
+
+        // horizontal angle by recurrence, kept in double to avoid drift over a packet
+        const double theta_start = (double)data.com_horizontal_angle_start + data.param.theta_angle_bias;
+        double sin_theta = sin(theta_start);
+        double cos_theta = cos(theta_start);
+        for (int j = 0; j < in.num; j++)
         {
-            if (crc & 1)
-                crc = (crc >> 1) ^ 0xEDB88320;
-            else
-                crc = (crc >> 1);
+            sin_theta_[j] = (float)sin_theta;
+            cos_theta_[j] = (float)cos_theta;
+
+            const double sin_next = sin_theta * cos_theta_step_ + cos_theta * sin_theta_step_;
+            cos_theta = cos_theta * cos_theta_step_ - sin_theta * sin_theta_step_;
+            sin_theta = sin_next;
         }
+
+        return kernel(in, out);
+    }
+
+    /**
+     * @brief Project the points of a packet straight into the columns of cloud,
+     *        appended after the points already there
+     * @return number of points appended
+     */
+    int append(PointCloudSoA &cloud, const LidarPointData &data, float range_min, float range_max)
+    {
+        const size_t offset = cloud.size();
+        cloud.resize(offset + MAX_POINT_NUM + PROJECTION_KERNEL_SLACK);
+
+        const ProjectionKernelOutput out = {
+            cloud.x.data() + offset,
+            cloud.y.data() + offset,
+            cloud.z.data() + offset,
+            cloud.intensity.data() + offset,
+            cloud.time.data() + offset};
+        const int num = project(out, data, range_min, range_max);
+
+        cloud.resize(offset + num);
+        return num;
     }
-    return ~crc;
+
+    /**
+     * @brief Project the points of a packet into cloud.points (cleared first)
+     * @param[in] range_min allowed minimum point range in meters
+     * @param[in] range_max allowed maximum point range in meters
+     */
+    void project(PointCloudUnitree &cloud, const LidarPointData &data, float range_min, float range_max)
+    {
+        const ProjectionKernelOutput out = {scratch_x_, scratch_y_, scratch_z_, scratch_intensity_, scratch_time_};
+        const int num = project(out, data, range_min, range_max);
+
+        cloud.points.resize(num);
+        for (int k = 0; k < num; k++)
+        {
+            PointUnitree &point3d = cloud.points[k];
+            point3d.x = scratch_x_[k];
+            point3d.y = scratch_y_[k];
+            point3d.z = scratch_z_[k];
+            point3d.intensity = scratch_intensity_[k];
+            point3d.time = scratch_time_[k];
+            point3d.ring = 1;
+        }
+    }
+
+private:
+    bool valid_ = false;
+    LidarCalibParam param_;
+    float angle_min_ = 0;
+    float angle_increment_ = 0;
+    float theta_step_ = 0;
+
+    double sin_theta_step_ = 0;
+    double cos_theta_step_ = 1;
+
+    // per-beam tables, rebuilt on calibration change
+    alignas(32) float coef_a_[MAX_POINT_NUM]; // A = coef_a * range + b_axis_dist
+    alignas(32) float coef_b_[MAX_POINT_NUM]; // B = coef_b * range
+    alignas(32) float coef_c_[MAX_POINT_NUM]; // z = coef_c * range + a_axis_dist
+
+    // per-packet horizontal angle tables
+    alignas(32) float sin_theta_[MAX_POINT_NUM];
+    alignas(32) float cos_theta_[MAX_POINT_NUM];
+
+    // kernel output for the point cloud overload
+    alignas(32) float scratch_x_[MAX_POINT_NUM + PROJECTION_KERNEL_SLACK];
+    alignas(32) float scratch_y_[MAX_POINT_NUM + PROJECTION_KERNEL_SLACK];
+    alignas(32) float scratch_z_[MAX_POINT_NUM + PROJECTION_KERNEL_SLACK];
+    alignas(32) float scratch_intensity_[MAX_POINT_NUM + PROJECTION_KERNEL_SLACK];
+    alignas(32) float scratch_time_[MAX_POINT_NUM + PROJECTION_KERNEL_SLACK];
+};
+
+/**
+ * @brief Projector of the calling thread, its tables survive between packets
+ */
+inline PointCloudProjector &threadLocalProjector()
+{
+    thread_local PointCloudProjector projector;
+    return projector;
 }
 
 /**
@@ -123,6 +499,7 @@ inline uint32_t crc32(const uint8_t *buf, uint32_t len)
  * @param[in] use_system_timestamp use system timestamp, otherwise use lidar hardware timestamp
  * @param[in] range_min allowed minimum point range in meters
  * @param[in] range_max allowed maximum point range in meters
+ * @note The projection tables are cached per thread, see threadLocalProjector().
  */
 inline void parseFromPacketToPointCloud(
     PointCloudUnitree &cloud,
@@ -132,94 +509,49 @@ inline void parseFromPacketToPointCloud(
     float range_max = 100
     )
 {
-    // scan info
-    const int num_of_points = packet.data.point_num;
-    const float time_step = packet.data.time_increment;
-    const float scan_period = packet.data.scan_period;
-
-    // intermediate variables
-    const float sin_beta = sin(packet.data.param.beta_angle);
-    const float cos_beta = cos(packet.data.param.beta_angle);
-    const float sin_xi = sin(packet.data.param.xi_angle);
-    const float cos_xi = cos(packet.data.param.xi_angle);
-    const float cos_beta_sin_xi = cos_beta * sin_xi;
-    const float sin_beta_cos_xi = sin_beta * cos_xi;
-    const float sin_beta_sin_xi = sin_beta * sin_xi;
-    const float cos_beta_cos_xi = cos_beta * cos_xi;
-
     // cloud init
     if (use_system_timestamp)
     {
-        cloud.stamp = getSystemTimeStamp() - scan_period;
+        cloud.stamp = getSystemTimeStamp() - packet.data.scan_period;
     }else{
         cloud.stamp = packet.data.info.stamp.sec + packet.data.info.stamp.nsec / 1.0e9;
     }
     cloud.id = 1;
     cloud.ringNum = 1;
-    cloud.points.clear();
-    cloud.points.reserve(300);
 
     // transform raw data to a pointcloud
-    auto &ranges = packet.data.ranges;
-    auto &intensities = packet.data.intensities;
-
-    float time_relative = 0;
-    float alpha_cur = packet.data.angle_min + packet.data.param.alpha_angle_bias;
-    float alpha_step = packet.data.angle_increment;
-    float theta_cur = packet.data.com_horizontal_angle_start + packet.data.param.theta_angle_bias;
-    float theta_step = packet.data.com_horizontal_angle_step;
-
-    float range_float;
-    float sin_alpha, cos_alpha, sin_theta, cos_theta;
-    float A, B, C;
-
-    PointUnitree point3d;
-    point3d.ring = 1;
-    // std::cout << "packet.data.param.range_scale = " << packet.data.param.range_scale << std::endl;
+    threadLocalProjector().project(cloud, packet.data, range_min, range_max);
+}
 
-    for (int j = 0; j < num_of_points; j += 1, alpha_cur += alpha_step,
-             theta_cur += theta_step, time_relative += time_step)
+/**
+ * @brief Parse from a point packet to a 3D point cloud in columns
+ * @param[out] cloud
+ * @param[in] packet lidar point data packet
+ * @param[in] use_system_timestamp use system timestamp, otherwise use lidar hardware timestamp
+ * @param[in] range_min allowed minimum point range in meters
+ * @param[in] range_max allowed maximum point range in meters
+ */
+inline void parseFromPacketToPointCloud(
+    PointCloudSoA &cloud,
+    const LidarPointDataPacket &packet,
+    bool use_system_timestamp = true,
+    float range_min = 0,
+    float range_max = 100
+    )
+{
+    // cloud init
+    if (use_system_timestamp)
     {
-        // jump invalid points
-        if (ranges[j] < 1)
-        {
-            continue;
-        }
-
-        // calculate point range in float type
-        range_float = packet.data.param.range_scale * ((float)ranges[j] + packet.data.param.range_bias);
-
-        // jump points beyond range limit
-        if ( range_float < packet.data.range_min || range_float > packet.data.range_max)
-        {
-            continue;
-        }
-
-        // jump points beyond range limit
-        if (range_float < range_min || range_float > range_max)
-        {
-            continue;
-        }
-
-        // transform to XYZ coordinate
-        sin_alpha = sin(alpha_cur);
-        cos_alpha = cos(alpha_cur);
-        sin_theta = sin(theta_cur);
-        cos_theta = cos(theta_cur);
-
-        A = (-cos_beta_sin_xi + sin_beta_cos_xi * sin_alpha) * range_float + packet.data.param.b_axis_dist;
-        B = cos_alpha * cos_xi * range_float;
-        C = (sin_beta_sin_xi + cos_beta_cos_xi * sin_alpha) * range_float;
-
-        point3d.x = cos_theta * A - sin_theta * B;
-        point3d.y = sin_theta * A + cos_theta * B;
-        point3d.z = C + packet.data.param.a_axis_dist;
-
-        // push back this point to cloud
-        point3d.intensity = intensities[j];
-        point3d.time = time_relative;
-        cloud.points.push_back(point3d);
+        cloud.stamp = getSystemTimeStamp() - packet.data.scan_period;
+    }else{
+        cloud.stamp = packet.data.info.stamp.sec + packet.data.info.stamp.nsec / 1.0e9;
     }
+    cloud.id = 1;
+    cloud.ringNum = 1;
+    cloud.clear();
+
+    // transform raw data to the point columns
+    threadLocalProjector().append(cloud, packet.data, range_min, range_max);
 }
 
 /**
@@ -0,0 +1,174 @@
+#pragma once
+
+#include <stdint.h>
+#include <cmath>
+#include <stdexcept>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @brief Incremental voxel-grid downsampler
+ * @note Every voxel keeps the running sums of its points, so frames are inserted in
+ *       O(points) and the downsampled cloud (voxel centroids and mean intensities) can be
+ *       emitted at any time. Voxels are anchored at the origin, floor(p / voxel_size),
+ *       not at the bounding box minimum like open3d's voxel_down_sample, since the final
+ *       extent is unknown while accumulating. Voxels are emitted in first-seen order.
+ */
+class VoxelAccumulator
+{
+public:
+    explicit VoxelAccumulator(double voxel_size = 0.02) : voxel_size_(voxel_size), inv_voxel_(1.0 / voxel_size)
+    {
+        if (!(voxel_size > 0) || !std::isfinite(voxel_size))
+        {
+            throw std::invalid_argument("voxel_size must be positive and finite.");
+        }
+    }
+
+    double voxelSize() const { return voxel_size_; }
+
+    /**
+     * @brief Number of occupied voxels
+     */
+    size_t size() const { return voxels_.size(); }
+
+    /**
+     * @brief Number of points accumulated so far
+     */
+    uint64_t pointCount() const { return point_count_; }
+
+    void clear()
+    {
+        index_.clear();
+        voxels_.clear();
+        point_count_ = 0;
+    }
+
+    /**
+     * @brief Accumulate one point
+     * @return false if a coordinate is not finite, the point is skipped then
+     */
+    bool insert(double x, double y, double z, double intensity)
+    {
+        Key key;
+        if (!voxelOf(x, key.x) || !voxelOf(y, key.y) || !voxelOf(z, key.z))
+        {
+            return false;
+        }
+
+        auto it = index_.find(key);
+        if (it == index_.end())
+        {
+            it = index_.emplace(key, (uint32_t)voxels_.size()).first;
+            voxels_.emplace_back();
+        }
+
+        Voxel &voxel = voxels_[it->second];
+        voxel.x += x;
+        voxel.y += y;
+        voxel.z += z;
+        voxel.intensity += intensity;
+        voxel.count++;
+        point_count_++;
+        return true;
+    }
+
+    /**
+     * @brief Accumulate n row-major points, `stride` values per point
+     * @param intensity one value per point, may be nullptr
+     * @return number of points accumulated
+     */
+    template <typename T, typename I>
+    size_t insertRows(const T *points, size_t stride, const I *intensity, size_t n)
+    {
+        size_t inserted = 0;
+        for (size_t i = 0; i < n; i++)
+        {
+            const T *p = points + i * stride;
+            inserted += insert(p[0], p[1], p[2], intensity ? (double)intensity[i] : 0.0);
+        }
+        return inserted;
+    }
+
+    /**
+     * @brief Accumulate n points stored as columns
+     * @return number of points accumulated
+     */
+    size_t insertColumns(const float *x, const float *y, const float *z, const float *intensity, size_t n)
+    {
+        size_t inserted = 0;
+        for (size_t i = 0; i < n; i++)
+        {
+            inserted += insert(x[i], y[i], z[i], intensity[i]);
+        }
+        return inserted;
+    }
+
+    /**
+     * @brief Voxel centroids, row-major (size(), 3)
+     */
+    void centroids(double *out) const
+    {
+        for (const Voxel &voxel : voxels_)
+        {
+            const double inv = 1.0 / voxel.count;
+            *out++ = voxel.x * inv;
+            *out++ = voxel.y * inv;
+            *out++ = voxel.z * inv;
+        }
+    }
+
+    /**
+     * @brief Mean intensity of every voxel
+     */
+    void intensities(double *out) const
+    {
+        for (const Voxel &voxel : voxels_)
+        {
+            *out++ = voxel.intensity / voxel.count;
+        }
+    }
+
+private:
+    struct Key
+    {
+        int64_t x, y, z;
+        bool operator==(const Key &other) const { return x == other.x && y == other.y && z == other.z; }
+    };
+
+    struct KeyHash
+    {
+        size_t operator()(const Key &key) const
+        {
+            uint64_t h = (uint64_t)key.x * 0x9E3779B97F4A7C15ull;
+            h ^= (uint64_t)key.y * 0xC2B2AE3D27D4EB4Full + (h << 6) + (h >> 2);
+            h ^= (uint64_t)key.z * 0x165667B19E3779F9ull + (h << 6) + (h >> 2);
+            return (size_t)h;
+        }
+    };
+
+    struct Voxel
+    {
+        double x = 0, y = 0, z = 0;
+        double intensity = 0;
+        uint32_t count = 0;
+    };
+
+    bool voxelOf(double v, int64_t &index) const
+    {
+        const double cell = std::floor(v * inv_voxel_);
+        // beyond 2^53 voxels the key is meaningless anyway
+        if (!(std::fabs(cell) < 9007199254740992.0))
+        {
+            return false;
+        }
+        index = (int64_t)cell;
+        return true;
+    }
+
+    double voxel_size_;
+    double inv_voxel_;
+    uint64_t point_count_ = 0;
+    std::unordered_map<Key, uint32_t, KeyHash> index_; // voxel key -> voxel
+    std::vector<Voxel> voxels_;                        // insertion order
+};
@@ -10,6 +10,8 @@ server_install_cmd_fmt = "pyinstaller -y --distpath dist-{sys}-{dev} --workpath
 ## linux, x86_64/aarch64
 client_install_cmd_fmt = "pyinstaller -y --distpath dist-{sys}-{dev} --workpath pybuild \
 --add-binary 'build/djset.cpython-{py_v_major}{py_v_minor}-{dev}-linux-gnu.so:.' \
+--add-binary 'build/grid.cpython-{py_v_major}{py_v_minor}-{dev}-linux-gnu.so:.' \
+--add-binary 'build/pcdops.cpython-{py_v_major}{py_v_minor}-{dev}-linux-gnu.so:.' \
 --add-binary 'build/lidar.cpython-{py_v_major}{py_v_minor}-{dev}-linux-gnu.so:.' \
 --collect-all open3d \
 --exclude-module open3d.cuda \
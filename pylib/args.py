@@ -102,7 +102,23 @@ def get_client_parser(DEFAULT_CONFIG_FILE='.config'):
     ## client
     parser.add_argument('--connect_type',
                         type=int, default=defaults.get('connect_type', 0),
-                        help="Connection type for the lidar: 0 for UDP, 1 for Serial.")
+                        help="Connection type for the lidar: 0 for UDP, 1 for Serial, 2 for replaying --replay_file, "
+                             "3 for UDP read in batches.")
+    parser.add_argument('--udp_batch',
+                        type=int, default=defaults.get('udp_batch', 64),
+                        help="Most packets read per syscall when connect_type is 3.")
+    parser.add_argument('--udp_receive_buffer',
+                        type=int, default=defaults.get('udp_receive_buffer', 8 << 20),
+                        help="Socket receive buffer requested in bytes when connect_type is 3.")
+    parser.add_argument('--replay_file',
+                        type=str, default=defaults.get('replay_file', ''),
+                        help="Capture replayed in a loop when connect_type is 2.")
+    parser.add_argument('--replay_speed',
+                        type=float, default=defaults.get('replay_speed', 1.0),
+                        help="Pace of the replay: 1 for real time, 0 for as fast as possible.")
+    parser.add_argument('--record_file',
+                        type=str, default=defaults.get('record_file', ''),
+                        help="Record the raw Lidar packets to this capture file, empty to disable.")
     parser.add_argument('--update_lowest_height',
                         action='store_true', default=defaults.get('update_lowest_height', True),
                         help="Update the lowest height found in the point cloud.")
@@ -112,6 +128,16 @@ def get_client_parser(DEFAULT_CONFIG_FILE='.config'):
     parser.add_argument('--point_batch',
                         type=int, default=defaults.get('point_batch', 12),
                         help="Batch number of points to process at once.")
+    parser.add_argument('--deskew',
+                        action='store_true', default=defaults.get('deskew', False),
+                        help="Compensate the sensor rotation during each frame with the IMU orientation.")
+    parser.add_argument('--extrinsic',
+                        type=json.loads, default=defaults.get('extrinsic', None),
+                        help="Row-major 4x4 rigid sensor to site transform in json of this Lidar, used by --fleet_configs.")
+    parser.add_argument('--fleet_configs',
+                        type=str, nargs='*', default=defaults.get('fleet_configs', []),
+                        help="Config files saved by the other Lidars of the site, fused with this one into one grid "
+                             "(connect_type 0 or 3 only).")
     parser.add_argument('--gather_times',
                         type=int, default=defaults.get('gather_times', 1),
                         help="Number of times to gather point cloud data.")
@@ -427,6 +453,9 @@ class ClientGUIArgs(tk.Tk):
         serial_radiobutton = tk.Radiobutton(connect_frame, text="串口 Serial", value=1, variable=var,
                                             **self.widget_font_kwargs)
         serial_radiobutton.grid(row=0, column=2, **self.widget_pad_kwargs)
+        batched_radiobutton = tk.Radiobutton(connect_frame, text="批量 UDP", value=3, variable=var,
+                                             **self.widget_font_kwargs)
+        batched_radiobutton.grid(row=0, column=3, **self.widget_pad_kwargs)
         self.entries['connect_type'] = widget
         row += 1
 
@@ -8,14 +8,18 @@ from pylib.misc import COLORS_MAP
 
 try:
     import djset
+    import grid
+    import pcdops
 except ImportError:
     try:
         import os, sys
 
         sys.path.append(os.path.join(os.path.dirname(os.path.dirname(os.path.abspath(__file__))), 'build'))
         import djset
+        import grid
+        import pcdops
     except ImportError:
-        print("Failed to import the djset module. Please ensure the build path is imported correctly.")
+        print("Failed to import the djset/grid/pcdops modules. Please ensure the build path is imported correctly.")
         sys.exit(1)
 
 logger = logging.getLogger()
@@ -57,35 +61,34 @@ def filter_points_within_square(pcd, length=2.0, below_lidar_threshold=0.1):
 
 
 ## [Filter]
-def extract_plane_points(points, degrees_threshold=5.0):
+def extract_plane_points(points, degrees_threshold=5.0, normal_radius=0.1, normal_max_nn=66):
     """ Extract plane points from the point cloud data.
 
     Args:
         points (np.ndarray): Array of points with shape (N, 3).
         degrees_threshold (float): Threshold in degrees for normal vector alignment.
+        normal_radius (float): Neighbourhood radius of the normal estimation.
+        normal_max_nn (int): Maximum number of (nearest) neighbours of the normal estimation.
     """
-    points = o3d.geometry.PointCloud(o3d.utility.Vector3dVector(points))
+    ## one native neighbour index serves the whole cleanup chain
+    index = pcdops.NeighbourIndex(points, cell_size=0.1)
 
     ## Remove outliers
-    points, _ = points.remove_radius_outlier(nb_points=2, radius=0.1)
-    # points, _ = points.remove_statistical_outlier(nb_neighbors=20, std_ratio=2.0)
+    index.select(index.radius_outlier_mask(nb_points=2, radius=0.1))
+    # index.select(index.statistical_outlier_mask(nb_neighbors=20, std_ratio=2.0))
 
-    ## Estimate normals
-    points.estimate_normals(search_param=o3d.geometry.KDTreeSearchParamKNN(knn=66))
-    normals = np.asarray(points.normals)  # (N, 3)
-
-    ## Filter points based on normals
-    z_axis = np.array([0, 0, 1], dtype=np.float64)
-    dot_products = normals @ z_axis
-
-    indices = np.where(np.abs(dot_products) > np.cos(np.pi / 180 * degrees_threshold))[0]
-    points = points.select_by_index(indices)
+    ## Estimate normals and filter points based on them
+    index.select(index.horizontal_plane_mask(
+        radius=normal_radius,
+        max_nn=normal_max_nn,
+        degrees_threshold=degrees_threshold
+    ))
 
     # Remove outliers
-    points, _ = points.remove_radius_outlier(nb_points=2, radius=0.1)
-    # points, _ = points.remove_statistical_outlier(nb_neighbors=20, std_ratio=2.0)
+    index.select(index.radius_outlier_mask(nb_points=2, radius=0.1))
+    # index.select(index.statistical_outlier_mask(nb_neighbors=20, std_ratio=2.0))
 
-    return np.asarray(points.points)
+    return index.get_active_points()
 
 
 ## [Filter]
@@ -104,13 +107,12 @@ def extract_non_floor_plane_points(points, lowest_height, floor_height_threshold
     if len(non_floor_points) == 0:
         return np.zeros((0, 3), dtype=np.float64)
 
-    ## remove noise
-    non_floor_points = o3d.geometry.PointCloud(o3d.utility.Vector3dVector(non_floor_points))
+    ## remove noise, both filters share one native neighbour index
+    index = pcdops.NeighbourIndex(non_floor_points, cell_size=0.1)
+    index.select(index.radius_outlier_mask(nb_points=2, radius=0.1))
+    index.select(index.statistical_outlier_mask(nb_neighbors=20, std_ratio=2.0))
 
-    non_floor_points, _ = non_floor_points.remove_radius_outlier(nb_points=2, radius=0.1)
-    non_floor_points, _ = non_floor_points.remove_statistical_outlier(nb_neighbors=20, std_ratio=2.0)
-
-    return np.asarray(non_floor_points.points)
+    return index.get_active_points()
 
 
 ## [Filter]
@@ -138,111 +140,18 @@ def compute_metrics_with_grid(all_collections_points, floor_height, grid_size=0.
         alert_height (float): Alarm height (m), used to determine the quadrant
         area_scale (float): Scale factor for the computed area.
         height_scale (float): Scale factor for the computed height.
+        min_valid_collections (int): Minimum number of collections that must see a grid cell for it to count.
     """
-    import numpy as np
-    if not all_collections_points:
-        return 0.0, 0.0, 0.0, 0.0, 0  # volume, area, max_h, mean_h, quadrant
-
-    # Combine all non-empty collections to determine overall spatial extent
-    all_points = np.vstack([p for p in all_collections_points if len(p) > 0])
-    if len(all_points) == 0:
-        return 0.0, 0.0, 0.0, 0.0, 0
-
-    # Calculate XY boundaries of the combined point cloud
-    min_x, max_x = np.min(all_points[:, 0]), np.max(all_points[:, 0])
-    min_y, max_y = np.min(all_points[:, 1]), np.max(all_points[:, 1])
-
-    # Determine grid dimensions based on spatial extent and grid size
-    grid_x_count = int(np.ceil((max_x - min_x) / grid_size))
-    grid_y_count = int(np.ceil((max_y - min_y) / grid_size))
-
-    collection_grid_data = []  # Store grid data for each collection
-
-    for collection_points in all_collections_points:
-        if len(collection_points) == 0:
-            # Empty collection: store empty dict
-            collection_grid_data.append({})
-            continue
-
-        # Map each point to its corresponding grid cell
-        ix = ((collection_points[:, 0] - min_x) / grid_size).astype(int)
-        iy = ((collection_points[:, 1] - min_y) / grid_size).astype(int)
-
-        # Filter out points that fall outside the grid boundaries
-        valid_mask = (ix >= 0) & (ix < grid_x_count) & (iy >= 0) & (iy < grid_y_count)
-        ix_valid = ix[valid_mask]
-        iy_valid = iy[valid_mask]
-        valid_points = collection_points[valid_mask]
-
-        # Create grid dictionary: key=(gx, gy), value=point indices
-        grid_dict = {}
-        for idx, (gx, gy) in enumerate(zip(ix_valid, iy_valid)):
-            grid_dict.setdefault((gx, gy), []).append(idx)
-
-        # For each grid, store the maximum height in this collection
-        grid_heights = {}
-        for (gx, gy), idx_list in grid_dict.items():
-            cell_points = valid_points[idx_list]
-            # Calculate height for each point and take maximum
-            heights = floor_height - cell_points[:, 2]
-            valid_heights = heights[heights > 0]  # Only consider points above floor
-            if len(valid_heights) > 0:
-                grid_heights[(gx, gy)] = np.max(valid_heights)
-
-        collection_grid_data.append(grid_heights)
-
-    # Count the effective collection times and total height of each grid
-    grid_valid_counts = np.zeros((grid_x_count, grid_y_count), dtype=int)
-    grid_height_sums = np.zeros((grid_x_count, grid_y_count))
-
-    # Process each collection's grid data
-    for grid_heights in collection_grid_data:
-        for (gx, gy), height in grid_heights.items():
-            if 0 <= gx < grid_x_count and 0 <= gy < grid_y_count:
-                grid_valid_counts[gx, gy] += 1
-                grid_height_sums[gx, gy] += height
-
-    total_volume = 0.0
-    total_area = 0.0
-    heights = []
-    max_height = -1
-    max_height_xy = (0, 0)
-    cell_area = grid_size * grid_size
-
-    # Process each grid cell to compute final metrics
-    for gx in range(grid_x_count):
-        for gy in range(grid_y_count):
-            n = grid_valid_counts[gx, gy]  # Number of collections that detected this grid
-
-            if n >= min_valid_collections:
-                # Height = average of the highest points in n collections
-                avg_height = (grid_height_sums[gx, gy] / n) * height_scale
-                volume = avg_height * (cell_area * area_scale)
-                area = cell_area * area_scale
-
-                total_volume += volume
-                total_area += area
-                heights.append(avg_height)
-
-                if avg_height > max_height:
-                    max_height = avg_height
-                    max_height_xy = (min_x + (gx + 0.5) * grid_size, min_y + (gy + 0.5) * grid_size)
-
-    mean_height = np.mean(heights) if len(heights) > 0 else 0.0
-
-    quadrant = 0
-    if max_height > alert_height:
-        x, y = max_height_xy
-        if x >= 0 and y >= 0:
-            quadrant = 1
-        elif x < 0 and y >= 0:
-            quadrant = 2
-        elif x < 0 and y < 0:
-            quadrant = 3
-        elif x >= 0 and y < 0:
-            quadrant = 4
-
-    return total_volume, total_area, max_height, mean_height, quadrant
+    ## per-cell max heights, valid counts and the final metrics are computed natively (cpplib/grid.cpp)
+    return grid.compute_metrics_with_grid(
+        all_collections_points,
+        floor_height=floor_height,
+        grid_size=grid_size,
+        alert_height=alert_height,
+        area_scale=area_scale,
+        height_scale=height_scale,
+        min_valid_collections=min_valid_collections
+    )
 
 
 ## [Rendering]
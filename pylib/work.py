@@ -7,11 +7,24 @@ import numpy as np
 import open3d as o3d
 from datetime import datetime
 
-from pylib.utils import filter_points_within_square, extract_plane_points, extract_non_floor_plane_points
-from pylib.utils import downsample_points, compute_metrics_with_grid
+from pylib.utils import extract_plane_points, extract_non_floor_plane_points
 from pylib.utils import upload_data_to_reporting_server, upload_file_to_reporting_server
 from pylib.misc import generate_stamp, COLORS_MAP
 
+try:
+    import lidar
+    import pcdops
+except ImportError:
+    try:
+        import sys
+
+        sys.path.append(os.path.join(os.path.dirname(os.path.dirname(os.path.abspath(__file__))), 'build'))
+        import lidar
+        import pcdops
+    except ImportError:
+        print("Failed to import the lidar/pcdops modules. Please ensure the build path is imported correctly.")
+        sys.exit(1)
+
 logger = logging.getLogger()
 
 SMOOTHING_WEIGHTS = {
@@ -28,40 +41,28 @@ def gather_point_cloud(args, manager, pcd_stamp=''):
 
     Args:
         args (argparse.Namespace): Parsed command line arguments.
-        manager (lidar.LidarManager): Lidar manager instance.
+        manager (lidar.LidarManager | lidar.LidarFleet): Lidar manager instance, or a fleet of calibrated
+            Lidars whose frames are fused into one grid.
         pcd_stamp (str): Optional stamp for the point cloud data.
     """
     ## get point cloud data from Lidar
-    pcd = o3d.geometry.PointCloud()
+    ## frames are cropped natively while packets are parsed (see LidarManager.enablePipeline)
+    ## and every batch goes into one voxel grid, the downsampled cloud is emitted once at the end
+    voxels = lidar.VoxelAccumulator(voxel_size=0.02)
     for i in range(args.gather_times):
         logger.info(f"Gathering point cloud data {i + 1}/{args.gather_times}...")
-        raw_points = manager.getPointCloudBatch(args.point_batch)
-        raw_points = np.array(raw_points, dtype=np.float64)[:, :4]
-
-        xyz = raw_points[:, :3]
-        xyz = np.ascontiguousarray(xyz, dtype=np.float64)
-        intensity = raw_points[:, 3]
+        manager.accumulatePointCloudBatch(voxels, args.point_batch)
 
+    pcd = o3d.geometry.PointCloud()
+    if len(voxels) > 0:
+        intensity = voxels.getIntensity()
         norm_i = (intensity - np.min(intensity)) / (np.max(intensity) - np.min(intensity) + 1e-8)
         norm_i = (norm_i * 191).astype(np.uint8)
         colors = COLORS_MAP[norm_i] / 255.0
         colors = np.ascontiguousarray(colors, dtype=np.float64)
 
-        batch_pcd = o3d.geometry.PointCloud()
-        batch_pcd.points = o3d.utility.Vector3dVector(xyz)
-        batch_pcd.colors = o3d.utility.Vector3dVector(colors)
-
-        ## filter xyz first.
-        batch_pcd = filter_points_within_square(
-            batch_pcd,
-            length=args.space_region_threshold,
-            below_lidar_threshold=args.lidar_height_threshold
-        )
-
-        ## Merge into global point cloud, and then
-        ## downsample the points, as the density of the points is uniform
-        pcd = pcd + batch_pcd
-        pcd = downsample_points(pcd, voxel_size=0.02)
+        pcd.points = o3d.utility.Vector3dVector(voxels.getPoints())
+        pcd.colors = o3d.utility.Vector3dVector(colors)
 
     ## save points if needed
     if args.save_point_cloud:
@@ -71,12 +72,52 @@ def gather_point_cloud(args, manager, pcd_stamp=''):
 
     return pcd
 
-def update_lowest_height(plane_points, args):
+def create_fleet(configs):
+    """ Create one fleet of the Lidars watching the same storage area.
+
+    Args:
+        configs (list[dict]): Configuration of every Lidar (see configs/), with its optional 4x4 "extrinsic"
+            sensor to site transform and "udp_batch", the packets read per syscall (0 for the SDK reader).
+    """
+    fleet = lidar.LidarFleet()
+    for config in configs:
+        device = fleet.addDeviceUDP(
+            config['lidar_ip'], config['lidar_ip'], config['lidar_port'],
+            config['local_ip'], config['local_port'],
+            length=config['space_region_threshold'],
+            below_lidar_threshold=config['lidar_height_threshold'],
+            deskew=config.get('deskew', False),
+            batch=config.get('udp_batch', 0)
+        )
+        if config.get('extrinsic') is not None:
+            fleet.setExtrinsic(device, np.asarray(config['extrinsic'], dtype=np.float64))
+        else:
+            logger.warning(f"Lidar {config['lidar_ip']} has no extrinsic, its points stay in its own frame.")
+    return fleet
+
+def fleet_site_length(configs):
+    """ Half side of the square around the site origin holding the crop square of every Lidar of a fleet,
+    moved into the site frame by its extrinsic, to size the height map of the fused grid.
+
+    Args:
+        configs (list[dict]): Configuration of every Lidar, see create_fleet().
+    """
+    length = 0.0
+    for config in configs:
+        l = config['space_region_threshold']
+        corners = np.array([[-l, -l, 0, 1], [-l, l, 0, 1], [l, -l, 0, 1], [l, l, 0, 1]], dtype=np.float64)
+        if config.get('extrinsic') is not None:
+            corners = corners @ np.asarray(config['extrinsic'], dtype=np.float64).T
+        length = max(length, float(np.max(np.abs(corners[:, :2]))))
+    return length
+
+def update_lowest_height(plane_points, args, previous_height):
     """ Update the lowest height (floor height) based on the plane points.
 
     Args:
         plane_points (np.ndarray): Points that are likely part of the plane.
         args (argparse.Namespace): Parsed command line arguments.
+        previous_height (float): Lowest height kept when no floor plane can be fitted.
     """
     ## compute the lowest height from the plane points
     ## As the z+ axis is downwards, the lower point has larger z value
@@ -86,21 +127,23 @@ def update_lowest_height(plane_points, args):
     anchor_z = float(round(np.percentile(z, 90), 3))
     floor_points = plane_points[np.abs(z - anchor_z) < args.floor_height_threshold]
 
-    floor = o3d.geometry.PointCloud()
-    floor.points = o3d.utility.Vector3dVector(floor_points)
-
-    ## fit a plane to these floor points
-    plane_model, inliers = floor.segment_plane(
-        distance_threshold=args.floor_height_threshold / 2,
-        ransac_n=3,
-        num_iterations=len(floor_points) * 2
-    )
+    ## fit a plane to these floor points natively (MSAC with adaptive stopping and least squares refine)
+    ## fewer than 3 floor points or collinear ones (e.g. a single scan line) fit no plane
+    try:
+        plane_model, num_inliers, angle = pcdops.fit_plane(
+            floor_points,
+            distance_threshold=args.floor_height_threshold / 2,
+            num_iterations=len(floor_points) * 2
+        )
+    except ValueError as e:
+        logger.warning(f"No floor plane fitted to {len(floor_points)} points ({e}), "
+                       f"keeping the lowest height of {previous_height:.6f} m.")
+        return previous_height
     a, b, c, d = plane_model
     x_0_y_0_z = -d / c
-    normal = np.array([a, b, c]) / np.linalg.norm([a, b, c])
 
-    angle = np.arccos(np.dot(normal, np.array([0, 0, 1]))) * 180 / np.pi
-    logger.info(f"Detected lowest height (floor height): {x_0_y_0_z:.6f} m, angle with vertical: {angle:.3f} degrees.")
+    logger.info(f"Detected lowest height (floor height): {x_0_y_0_z:.6f} m, angle with vertical: {angle:.3f} degrees, "
+                f"{num_inliers}/{len(floor_points)} inliers.")
     return x_0_y_0_z
 
 def create_colored_plane_points(plane_points, floor_height, alert_height, height_scale,
@@ -179,15 +222,18 @@ def create_colored_plane_points(plane_points, floor_height, alert_height, height
 
     return plane_pcd
 
-def workflow(args, manager, history):
+def workflow(args, manager, history, height_map):
     """ Main workflow for processing point cloud data.
 
     Args:
         args (argparse.Namespace): Parsed command line arguments.
         manager (lidar.LidarManager): Lidar manager instance.
         history (collections.deque): History of previous results for smoothing.
+        height_map (grid.HeightMap): Height map of the storage area, cleared at the start of every cycle.
     """
-    all_cargo_points = []  # Store collection_times_per_cycle batches of goods in a flat point cloud
+    cargo_voxels = lidar.VoxelAccumulator(voxel_size=0.02)  # downsampled goods of this cycle
+    height_map.clear()  # only the collections of this cycle vote, like compute_metrics_with_grid
+    cargo_collections = 0
     batch_lowest_heights = []
     ## gather the point cloud data from the Lidar
     for i in range(args.collection_times_per_cycle):
@@ -214,7 +260,13 @@ def workflow(args, manager, history):
         ## we always use the smoothed lowest height for further processing
         lowest_z = args.lowest_height
         if args.update_lowest_height:
-            lowest_z = update_lowest_height(plane_points, args)
+            if batch_lowest_heights:
+                previous_z = batch_lowest_heights[-1]
+            elif history:
+                previous_z = history[-1]['lowest_z']
+            else:
+                previous_z = args.lowest_height
+            lowest_z = update_lowest_height(plane_points, args, previous_z)
             batch_lowest_heights.append(lowest_z)
             weight = SMOOTHING_WEIGHTS[len(history) + 1]
             lowest_z = np.sum(np.array([item['lowest_z'] for item in history] + [lowest_z]) * weight) / (
@@ -231,19 +283,24 @@ def workflow(args, manager, history):
             floor_height_threshold=args.floor_height_threshold
         )
 
+        ## the goods of this collection are a new collection of the height map
         if len(non_floor_plane_points) > 0:
-            all_cargo_points.append(non_floor_plane_points)
-
-    if not all_cargo_points:
+            height_map.begin_collection()
+            inserted = height_map.insert(non_floor_plane_points)
+            if inserted < len(non_floor_plane_points):
+                logger.warning(f"{len(non_floor_plane_points) - inserted}/{len(non_floor_plane_points)} points "
+                               f"are outside the height map and are not counted.")
+            cargo_voxels.insert(non_floor_plane_points)
+            cargo_collections += 1
+
+    if cargo_collections == 0:
         return None
 
     final_lowest_z = np.mean(batch_lowest_heights)
 
-    ## compute volume, area, and height from these point groups
-    volume, area, max_height, mean_height, quadrant = compute_metrics_with_grid(
-        all_cargo_points,
+    ## compute volume, area, and height from the collections kept by the height map
+    volume, area, max_height, mean_height, quadrant = height_map.compute_metrics(
         floor_height=final_lowest_z,
-        grid_size=args.grid_size,
         alert_height=args.alert_height,
         area_scale = args.area_scale,
         height_scale = args.height_scale,
@@ -259,14 +316,9 @@ def workflow(args, manager, history):
     max_height = np.sum(np.array([item['max_height'] for item in history] + [max_height]) * weight) / (np.sum(weight) + 1e-8)
     mean_height = np.sum(np.array([item['mean_height'] for item in history] + [mean_height]) * weight) / (np.sum(weight) + 1e-8)
 
-    # Merge t batch point clouds and downsample
-    merged_cargo_points = np.vstack(all_cargo_points)  # Merge the point cloud of batch T goods on the plane
-    merged_pcd = o3d.geometry.PointCloud()
-    merged_pcd.points = o3d.utility.Vector3dVector(merged_cargo_points)
-    downsampled_pcd = downsample_points(merged_pcd, voxel_size=0.02)
-
+    # The goods of the batches were downsampled while they were collected
     plane_pcd = create_colored_plane_points(
-        np.asarray(downsampled_pcd.points),
+        cargo_voxels.getPoints(),
         floor_height=final_lowest_z,
         alert_height=args.alert_height,
         height_scale=args.height_scale,
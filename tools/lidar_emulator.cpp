@@ -0,0 +1,417 @@
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <random>
+#include <string>
+#include <thread>
+
+#include "udp_handler.h"
+#include "lidar_capture.h"
+
+using namespace unilidar_sdk2;
+
+/**
+ * @brief Lidar emulator: answers the user commands of the SDK with ACKs and streams
+ *        point and IMU packets over UDP, so the readers can be exercised without hardware.
+ *
+ * The point packets are either synthetic (a room with a block of cargo on the floor,
+ * seen by a sensor at its center) or replayed from a capture (see lidar_capture.h).
+ * Usage: lidar_emulator [--peer_ip 127.0.0.1] [--peer_port 6201] [--lidar_port 6101]
+ *                       [--point_rate 216] [--imu_rate 250] [--rate_scale 1]
+ *                       [--replay capture.bin] [--seconds 0]
+ */
+
+typedef struct
+{
+    std::string peer_ip = "127.0.0.1"; // where the SDK listens, its local_ip
+    unsigned short peer_port = 6201;   // its local_port
+    unsigned short lidar_port = 6101;  // where the commands of the SDK arrive
+    double point_rate = 216;           // point packets per second
+    double imu_rate = 250;             // IMU packets per second
+    double rate_scale = 1;             // both rates (or the replay pace) are multiplied by this
+    std::string replay;                // capture to stream instead of the synthetic scene
+    double seconds = 0;                // stop after this long, 0 to run until killed
+} EmulatorOptions;
+
+static const int FRAME_PACKETS = 18; // point packets per revolution of the synthetic scan
+
+static void stampNow(DataInfo &info, uint32_t seq, uint32_t payload_size)
+{
+    info.seq = seq;
+    info.payload_size = payload_size;
+    getSystemTimeStamp(info.stamp);
+}
+
+/**
+ * @brief Distance along the unit ray d to the first face of the box [lo, hi] ahead, or -1
+ */
+static double rayBox(const double d[3], const double lo[3], const double hi[3])
+{
+    double near = 0, far = INFINITY;
+    for (int k = 0; k < 3; k++)
+    {
+        if (std::fabs(d[k]) < 1e-12)
+        {
+            if (lo[k] > 0 || hi[k] < 0)
+            {
+                return -1;
+            }
+            continue;
+        }
+        double t0 = lo[k] / d[k], t1 = hi[k] / d[k];
+        if (t0 > t1)
+        {
+            std::swap(t0, t1);
+        }
+        near = std::max(near, t0);
+        far = std::min(far, t1);
+    }
+    return near <= far ? (near > 0 ? near : far) : -1;
+}
+
+/**
+ * @brief Synthetic scan of a 6 x 6 m room, floor 3.5 m below the sensor (z points down)
+ *        and a 1.2 x 0.8 x 1 m block of cargo on the floor
+ */
+class SyntheticScene
+{
+public:
+    explicit SyntheticScene(double point_rate) : point_rate_(point_rate) {}
+
+    void pointPacket(LidarPointDataPacket &packet, uint32_t seq)
+    {
+        memset(&packet, 0, sizeof(packet));
+        LidarPointData &data = packet.data;
+        stampNow(data.info, seq, sizeof(LidarPointData));
+
+        data.param.range_scale = 0.001f;
+        data.range_min = 0;
+        data.range_max = 60;
+        data.point_num = PointCloudProjector::MAX_POINT_NUM;
+        data.angle_min = 0;
+        data.angle_increment = (float)(M_PI / data.point_num);
+        data.time_increment = (float)(1.0 / (point_rate_ * data.point_num));
+        data.scan_period = (float)(FRAME_PACKETS / point_rate_);
+
+        // one fan from straight down through the horizon per packet, spun around z
+        const double theta_per_packet = 2 * M_PI / FRAME_PACKETS + 0.0137; // drift so revolutions differ
+        data.com_horizontal_angle_start = (float)std::fmod(seq * theta_per_packet, 2 * M_PI);
+        data.com_horizontal_angle_step = (float)(theta_per_packet / data.point_num);
+
+        for (uint32_t j = 0; j < data.point_num; j++)
+        {
+            // beam direction of the projection with a zero calibration
+            const double alpha = data.angle_min + j * (double)data.angle_increment;
+            const double theta = data.com_horizontal_angle_start + j * (double)data.com_horizontal_angle_step;
+            const double d[3] = {-std::sin(theta) * std::cos(alpha), std::cos(theta) * std::cos(alpha), std::sin(alpha)};
+
+            double range = rayBox(d, ROOM_LO, ROOM_HI);
+            const double cargo = rayBox(d, CARGO_LO, CARGO_HI);
+            const bool hits_cargo = cargo > 0 && cargo < range;
+            if (hits_cargo)
+            {
+                range = cargo;
+            }
+            if (range <= 0)
+            {
+                continue;
+            }
+            range += noise_(rng_);
+            data.ranges[j] = (uint16_t)std::min(65535.0, std::max(0.0, range * 1000));
+            data.intensities[j] = (uint8_t)(hits_cargo ? 200 : 60 + j % 40);
+        }
+        framePacket(packet, LIDAR_POINT_DATA_PACKET_TYPE);
+    }
+
+    /**
+     * @brief IMU of a sensor swaying 0.5 degree at 3 Hz around x
+     */
+    void imuPacket(LidarImuDataPacket &packet, uint32_t seq, double t)
+    {
+        memset(&packet, 0, sizeof(packet));
+        LidarImuData &data = packet.data;
+        stampNow(data.info, seq, sizeof(LidarImuData));
+
+        const double w = 2 * M_PI * 3;
+        const double roll = 0.5 * DEGREE_TO_RADIAN * std::sin(w * t);
+        data.quaternion[0] = (float)std::sin(roll / 2);
+        data.quaternion[1] = 0;
+        data.quaternion[2] = 0;
+        data.quaternion[3] = (float)std::cos(roll / 2);
+        data.angular_velocity[0] = (float)(0.5 * DEGREE_TO_RADIAN * w * std::cos(w * t));
+        data.linear_acceleration[2] = 9.81f;
+        framePacket(packet, LIDAR_IMU_DATA_PACKET_TYPE);
+    }
+
+private:
+    static constexpr double ROOM_LO[3] = {-3, -3, -1};
+    static constexpr double ROOM_HI[3] = {3, 3, 3.5};
+    static constexpr double CARGO_LO[3] = {0.5, -1.0, 2.5};
+    static constexpr double CARGO_HI[3] = {1.7, -0.2, 3.5};
+
+    double point_rate_;
+    std::mt19937 rng_{7};
+    std::normal_distribution<double> noise_{0.0, 0.005};
+};
+
+constexpr double SyntheticScene::ROOM_LO[3];
+constexpr double SyntheticScene::ROOM_HI[3];
+constexpr double SyntheticScene::CARGO_LO[3];
+constexpr double SyntheticScene::CARGO_HI[3];
+
+class LidarEmulator
+{
+public:
+    explicit LidarEmulator(const EmulatorOptions &options)
+        : options_(options), udp_(new UDPHandler(options.lidar_port)), scene_(options.point_rate * options.rate_scale)
+    {
+    }
+
+    int run()
+    {
+        if (udp_->CreateSocket() < 0 || udp_->Bind() < 0)
+        {
+            printf("Can not bind the lidar port %d!\n", options_.lidar_port);
+            return -1;
+        }
+        udp_->SetRecvTimeout(1);
+
+        if (!options_.replay.empty() &&
+            replay_.initializeReplay(options_.replay, options_.rate_scale, true, FRAME_PACKETS))
+        {
+            printf("Can not replay %s, it is not a capture!\n", options_.replay.c_str());
+            return -1;
+        }
+
+        printf("Emulating a lidar on port %d, streaming to %s:%d\n", options_.lidar_port,
+               options_.peer_ip.c_str(), options_.peer_port);
+
+        std::thread commands(&LidarEmulator::commandLoop, this);
+        streamLoop();
+        running_ = false;
+        commands.join();
+        udp_->Close();
+        return 0;
+    }
+
+private:
+    template <typename Packet>
+    void send(const Packet &packet)
+    {
+        udp_->Send((const char *)&packet, sizeof(Packet), &options_.peer_ip[0], options_.peer_port);
+    }
+
+    void sendAck(uint32_t packet_type, uint32_t cmd_type, uint32_t cmd_value)
+    {
+        LidarAckDataPacket ack;
+        memset(&ack, 0, sizeof(ack));
+        ack.data.packet_type = packet_type;
+        ack.data.cmd_type = cmd_type;
+        ack.data.cmd_value = cmd_value;
+        ack.data.status = ACK_SUCCESS;
+        framePacket(ack, LIDAR_ACK_DATA_PACKET_TYPE);
+        send(ack);
+    }
+
+    void sendVersion()
+    {
+        LidarVersionDataPacket version;
+        memset(&version, 0, sizeof(version));
+        const uint8_t hw[4] = {1, 0, 0, 0}, sw[4] = {2, 0, 0, 0};
+        memcpy(version.data.hw_version, hw, 4);
+        memcpy(version.data.sw_version, sw, 4);
+        strncpy((char *)version.data.name, "L2 emulator", sizeof(version.data.name) - 1);
+        memcpy(version.data.date, "20260101", sizeof(version.data.date));
+        framePacket(version, LIDAR_VERSION_PACKET_TYPE);
+        send(version);
+    }
+
+    /**
+     * @brief Answer the packets of the SDK: version requests with a version packet,
+     *        standby toggles the stream, everything else is acknowledged
+     */
+    void commandLoop()
+    {
+        std::vector<char> buffer(2048);
+        sockaddr_in from;
+        while (running_)
+        {
+            const int size = udp_->Recv(buffer.data(), buffer.size(), &from);
+            if (size <= 0)
+            {
+                continue;
+            }
+
+            const uint32_t packet_type = checkPacketFrame((const uint8_t *)buffer.data(), size);
+            if (packet_type == 0)
+            {
+                printf("Dropped a malformed packet of %d bytes\n", size);
+                continue;
+            }
+
+            if (packet_type != LIDAR_USER_CMD_PACKET_TYPE && packet_type != LIDAR_COMMAND_PACKET_TYPE)
+            {
+                // work mode, addresses, time stamp sync: acknowledged and ignored
+                sendAck(packet_type, 0, 0);
+                continue;
+            }
+
+            // user commands and the internal commands of the SDK share the layout, not the numbering
+            const LidarUserCtrlCmd *cmd = (const LidarUserCtrlCmd *)(buffer.data() + sizeof(FrameHeader));
+            const bool user = packet_type == LIDAR_USER_CMD_PACKET_TYPE;
+            if (cmd->cmd_type == (user ? USER_CMD_STANDBY_TYPE : CMD_STANDBY_TYPE))
+            {
+                streaming_ = cmd->cmd_value == 0;
+                printf("Lidar %s\n", streaming_ ? "started" : "in standby");
+            }
+            else if (cmd->cmd_type == (user ? USER_CMD_VERSION_GET : CMD_VERSION_GET))
+            {
+                sendVersion();
+            }
+            sendAck(packet_type, cmd->cmd_type, cmd->cmd_value);
+        }
+    }
+
+    void streamLoop()
+    {
+        typedef std::chrono::steady_clock Clock;
+        const auto start = Clock::now();
+        const auto point_period = std::chrono::duration<double>(1.0 / (options_.point_rate * options_.rate_scale));
+        const auto imu_period = std::chrono::duration<double>(1.0 / (options_.imu_rate * options_.rate_scale));
+        auto next_point = start, next_imu = start, next_report = start + std::chrono::seconds(1);
+
+        LidarPointDataPacket point;
+        LidarImuDataPacket imu;
+        uint32_t point_seq = 0, imu_seq = 0;
+        uint64_t points_sent = 0, imus_sent = 0;
+
+        while (running_)
+        {
+            const auto now = Clock::now();
+            if (options_.seconds > 0 && now - start > std::chrono::duration<double>(options_.seconds))
+            {
+                break;
+            }
+            if (now >= next_report)
+            {
+                printf("%lu point and %lu IMU packets sent in the last second\n",
+                       (unsigned long)points_sent, (unsigned long)imus_sent);
+                points_sent = imus_sent = 0;
+                next_report += std::chrono::seconds(1);
+            }
+
+            if (!streaming_)
+            {
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+                next_point = next_imu = Clock::now();
+                continue;
+            }
+
+            if (!options_.replay.empty())
+            {
+                // the replay reader paces the capture itself
+                const int result = replay_.runParse();
+                if (result == LIDAR_POINT_DATA_PACKET_TYPE)
+                {
+                    send(replay_.getLidarPointDataPacket());
+                    points_sent++;
+                }
+                else if (result == LIDAR_IMU_DATA_PACKET_TYPE)
+                {
+                    send(replay_.getLidarImuDataPacket());
+                    imus_sent++;
+                }
+                else if (result == 0)
+                {
+                    std::this_thread::sleep_for(std::chrono::microseconds(100));
+                }
+                continue;
+            }
+
+            if (now >= next_point)
+            {
+                scene_.pointPacket(point, point_seq++);
+                send(point);
+                points_sent++;
+                next_point += std::chrono::duration_cast<Clock::duration>(point_period);
+            }
+            if (now >= next_imu)
+            {
+                scene_.imuPacket(imu, imu_seq++, std::chrono::duration<double>(now - start).count());
+                send(imu);
+                imus_sent++;
+                next_imu += std::chrono::duration_cast<Clock::duration>(imu_period);
+            }
+            std::this_thread::sleep_until(std::min(next_point, next_imu));
+        }
+    }
+
+    EmulatorOptions options_;
+    // never destroyed: the destructor shipped in libunilidar_sdk2.a calls itself until the
+    // stack overflows, the socket is closed explicitly instead
+    UDPHandler *udp_;
+    SyntheticScene scene_;
+    ReplayLidarReader replay_;
+    std::atomic<bool> running_{true};
+    std::atomic<bool> streaming_{true};
+};
+
+int main(int argc, char *argv[])
+{
+    EmulatorOptions options;
+    for (int i = 1; i < argc; i += 2)
+    {
+        const std::string key = argv[i];
+        if (i + 1 >= argc)
+        {
+            printf("Option %s has no value\n", key.c_str());
+            return -1;
+        }
+        const char *value = argv[i + 1];
+        if (key == "--peer_ip")
+        {
+            options.peer_ip = value;
+        }
+        else if (key == "--peer_port")
+        {
+            options.peer_port = (unsigned short)atoi(value);
+        }
+        else if (key == "--lidar_port")
+        {
+            options.lidar_port = (unsigned short)atoi(value);
+        }
+        else if (key == "--point_rate")
+        {
+            options.point_rate = atof(value);
+        }
+        else if (key == "--imu_rate")
+        {
+            options.imu_rate = atof(value);
+        }
+        else if (key == "--rate_scale")
+        {
+            options.rate_scale = atof(value);
+        }
+        else if (key == "--replay")
+        {
+            options.replay = value;
+        }
+        else if (key == "--seconds")
+        {
+            options.seconds = atof(value);
+        }
+        else
+        {
+            printf("Unknown option %s\n", key.c_str());
+            return -1;
+        }
+    }
+    if (options.point_rate <= 0 || options.imu_rate <= 0 || options.rate_scale <= 0)
+    {
+        printf("Rates must be positive!\n");
+        return -1;
+    }
+
+    LidarEmulator emulator(options);
+    return emulator.run();
+}